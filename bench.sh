@@ -0,0 +1,88 @@
+#!/bin/sh
+#
+# Benchmarks write-mode remap throughput as node memories grow past 2^31
+# pages, on a blocky write set (so that node memories are range trees, and a
+# pass costs O(runs log M) for M-page memories), and on a dense one (so that
+# they're page counters, of which a pass touches only those the write set
+# lands on). Prints a CSV row per write set and memory size; remaps/s should
+# fall off only logarithmically with it for the blocky write set, and hardly
+# at all for the dense one. The dense runs use a lower endurance, since their
+# resident memory grows with the counters they've written.
+# Then benchmarks full passes over page counters: a dense 2^22-page write set
+# on node memories its own size, so that every pass sweeps all of their
+# counters, with counters of the default width (32 bits, here) and of 64 bits
+# (-w 64). Throughput here is bound by the bytes of counters (held one array
+# per node memory) each pass pulls through the cache. Setting ENDURER to
+# another build (e.g. one from before a layout change) benchmarks that one
+# instead; rows with arguments it doesn't take report no remaps.
+# With "--large-write-set", also runs a (sparse-file) write set of over 2^31
+# pages itself, which takes 16 GiB of disk address space, but only a few MiB
+# of actual disk.
+#
+# Usage: [ENDURER=<BUILD>] ./bench.sh [--large-write-set]
+
+set -e
+
+ENDURER="${ENDURER:-$(dirname "$0")/bin/endurer}"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# writes a write set of n_pages entries to a file: runs of 4096 pages, each
+# of 0-3 writes, over the first 2^16 pages, and zeros beyond them
+make_write_set() {
+    truncate -s $(($2 * 8)) "$1"
+    perl -e 'print pack("Q<*", map { ($_ >> 12) % 4 } 0 .. 65535)' |
+            dd of="$1" conv=notrunc status=none
+}
+
+# writes a dense write set of n_pages entries to a file: 0-3 writes per
+# page, pseudorandomly
+make_dense_write_set() {
+    perl -e 'print pack("Q<*", map { (($_ * 2654435761) >> 16) % 4 }
+            0 .. $ARGV[0] - 1)' "$2" > "$1"
+}
+
+# runs a single write-mode simulation of the given write set, of the given
+# number of pages, on node memories of the given size (or, if empty, the
+# default), with the given further arguments, and prints its CSV row
+run() {
+    label=$1 write_set=$2 memory_pages=$3 write_set_pages=$4
+    shift 4
+
+    start=$(date +%s.%N)
+    n_remaps=$("$ENDURER" -m write -p 4096 -t 1 -i "$write_set" \
+            ${memory_pages:+--memory-pages "$memory_pages"} "$@" |
+            sed -n 's/^n\. remaps: //p')
+    end=$(date +%s.%N)
+
+    echo "$label,${memory_pages:-$write_set_pages},$write_set_pages,$n_remaps" |
+            awk -F, -v s="$start" -v e="$end" \
+            '{ printf "%s,%s,%s,%s,%.3f,%.0f\n", $1, $2, $3, $4, e - s,
+            $4 / (e - s) }'
+}
+
+echo "write_set,memory_pages,write_set_pages,n_remaps,seconds,remaps_per_second"
+
+make_write_set "$WORK_DIR/small.bin" 65536
+make_dense_write_set "$WORK_DIR/dense.bin" 65536
+for memory_pages_log2 in 16 20 24 28 31 32 33 36 40; do
+    run blocky "$WORK_DIR/small.bin" $((1 << memory_pages_log2)) 65536 \
+            -c 100000 -r 100
+done
+for memory_pages_log2 in 16 20 24 28 31 32 33 36 40; do
+    run dense "$WORK_DIR/dense.bin" $((1 << memory_pages_log2)) 65536 \
+            -c 3000 -r 100
+done
+
+counters_n_pages=$((1 << 22))
+make_dense_write_set "$WORK_DIR/counters.bin" $counters_n_pages
+run counters "$WORK_DIR/counters.bin" "" $counters_n_pages -c 30000 -r 10
+run counters-64 "$WORK_DIR/counters.bin" "" $counters_n_pages -c 30000 -r 10 \
+        -w 64
+
+if [ "$1" = "--large-write-set" ]; then
+    large_n_pages=$(((1 << 31) + 65536))
+    make_write_set "$WORK_DIR/large.bin" $large_n_pages
+    run blocky "$WORK_DIR/large.bin" $((1 << 32)) $large_n_pages \
+            -c 100000 -r 100
+fi
@@ -0,0 +1,149 @@
+/*
+ * Converts a raw write-set dump (one 64-bit entry per page) into a
+ * self-describing write-set file (see write_set_file.h), recording its page
+ * size, time units, and any other metadata given, with a checksum per block
+ * of entries.
+ */
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "util.h"
+#include "write_set_file.h"
+
+
+static void
+write_output(int fd, const void* data, size_t size, uint64_t offset)
+{
+    if (!pwrite_all(fd, data, size, offset))
+        print_message_and_die("could not write output file");
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string input_filepath;
+    std::string output_filepath;
+    int64_t page_size = 0;
+    double time_units = 0;
+    uint64_t checksum_block_n_pages = WRITE_SET_MAX_CHECKSUM_BLOCK_N_PAGES;
+    std::string metadata;
+
+    int c;
+    opterr = 0; // global: don't explicitly warn on unrecognized args
+    while ((c = getopt(argc, argv, "i:o:p:t:b:M:")) != -1) {
+        try {
+            switch (c) {
+                case 'i':
+                    input_filepath = optarg;
+                    break;
+                case 'o':
+                    output_filepath = optarg;
+                    break;
+                case 'p':
+                    page_size = std::stol(optarg);
+                    break;
+                case 't':
+                    time_units = std::stod(optarg);
+                    break;
+                case 'b':
+                    checksum_block_n_pages = std::stoull(optarg);
+                    break;
+                case 'M':
+                    metadata += optarg;
+                    metadata += '\n';
+                    break;
+                case '?':
+                    print_message_and_die("unrecognized argument");
+            }
+        }
+        catch (...) {
+            print_message_and_die("generic arg parse failure");
+        }
+    }
+
+    if (optind != argc)
+            print_message_and_die("each argument must be accompanied by a "
+            "flag");
+    if (input_filepath.empty() or output_filepath.empty())
+        print_message_and_die("must supply input and output files: "
+                "<-i RAW_FILE> <-o OUTPUT_FILE>");
+    if (page_size < 0 or time_units < 0)
+        print_message_and_die("page size and time units must be positive "
+                "(or omitted): <-p PAGE_SIZE> <-t TIME_UNITS>");
+    if ((checksum_block_n_pages & (checksum_block_n_pages - 1)) != 0 or
+            checksum_block_n_pages > WRITE_SET_MAX_CHECKSUM_BLOCK_N_PAGES)
+        print_message_and_die("checksum blocks must be a power of two of at "
+                "most %zu pages (or 0, for none): <-b N_PAGES>",
+                WRITE_SET_MAX_CHECKSUM_BLOCK_N_PAGES);
+
+    int input_fd = open(input_filepath.c_str(), O_RDONLY);
+    if (input_fd == -1) print_message_and_die("could not open input file");
+    struct stat input_file_stat;
+    if (fstat(input_fd, &input_file_stat) != 0)
+        print_message_and_die("could not stat input file");
+    if (input_file_stat.st_size == 0)
+        print_message_and_die("input file is empty");
+
+    write_set_file_info_t info;
+    read_write_set_file_info(input_fd, input_file_stat.st_size, &info);
+    if (info.payload_offset != 0)
+        print_message_and_die("input file is already self-describing");
+    posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    int output_fd = open(output_filepath.c_str(), O_WRONLY | O_CREAT |
+            O_TRUNC, 0644);
+    if (output_fd == -1) print_message_and_die("could not create output file");
+
+    // header and metadata, then the write set, then the checksums
+    write_set_header_t header = {};
+    memcpy(header.magic, WRITE_SET_MAGIC, sizeof(header.magic));
+    header.byte_order = WRITE_SET_BYTE_ORDER;
+    header.version = WRITE_SET_VERSION;
+    header.entry_bits = 64;
+    header.n_pages = info.n_pages;
+    header.payload_offset = (sizeof(header) + metadata.size() +
+            WRITE_SET_PAYLOAD_ALIGNMENT - 1) & ~(WRITE_SET_PAYLOAD_ALIGNMENT - 1);
+    header.page_size = page_size;
+    header.time_units = time_units;
+    header.checksum_block_n_pages = checksum_block_n_pages;
+    header.checksums_offset = checksum_block_n_pages == 0 ? 0 :
+            header.payload_offset + info.n_pages * sizeof(uint64_t);
+    header.metadata_size = metadata.size();
+    header.header_checksum = get_write_set_header_checksum(header, metadata);
+
+    write_output(output_fd, &header, sizeof(header), 0);
+    write_output(output_fd, metadata.data(), metadata.size(), sizeof(header));
+
+    uint64_t block_n_pages = checksum_block_n_pages != 0 ?
+            checksum_block_n_pages : WRITE_SET_MAX_CHECKSUM_BLOCK_N_PAGES;
+    std::vector<uint64_t> block(block_n_pages);
+    std::vector<uint64_t> checksums;
+    for (uint64_t first_page = 0; first_page < info.n_pages;
+            first_page += block_n_pages) {
+        uint64_t n_pages = MIN(block_n_pages, info.n_pages - first_page);
+        size_t block_size = n_pages * sizeof(uint64_t);
+
+        if (!pread_all(input_fd, block.data(), block_size,
+                first_page * sizeof(uint64_t)))
+            print_message_and_die("could not read input file");
+        write_output(output_fd, block.data(), block_size,
+                header.payload_offset + first_page * sizeof(uint64_t));
+        if (checksum_block_n_pages != 0)
+            checksums.push_back(get_write_set_checksum(block.data(), n_pages));
+    }
+    write_output(output_fd, checksums.data(), checksums.size() *
+            sizeof(uint64_t), header.checksums_offset);
+
+    if (fsync(output_fd) != 0 or close(output_fd) != 0)
+        print_message_and_die("could not write output file");
+    close(input_fd);
+
+    return 0;
+}
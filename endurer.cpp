@@ -1,23 +1,180 @@
+#include <fcntl.h>
+#include <getopt.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <fstream>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
 
 #include "util.h"
 #include "endurer.h"
+#include "kernels.h"
+#include "ntt.h"
+#include "philox.h"
+#include "range_max_tree.h"
+#include "write_set_file.h"
 
 
 Endurer::Endurer(int argc, char* argv[])
 {
     parse_and_validate_args(argc, argv);
 
+    thread_pool = new ThreadPool(n_threads, pin_threads);
+}
+
+/*
+ * A single run of a sweep: shares the sweep's (already-read) write sets, but
+ * simulates on its own node memories, with the given remap period (and, if
+ * replica isn't NO_REPLICA, that replica's random stream). The endurance only
+ * decides when a run stops, so a single run covers all of the swept ones (see
+ * finish_pass()). It runs on the calling thread alone, unless given a thread
+ * pool afterwards.
+ */
+Endurer::Endurer(const Endurer& sweep, double remap_period, int64_t replica) :
+        mode(sweep.mode),
+        page_size(sweep.page_size),
+        remap_period(remap_period),
+        input_time_units(sweep.input_time_units),
+        counter_bits(sweep.counter_bits),
+        n_threads(1),
+        fft_batch_periods(sweep.fft_batch_periods),
+        requested_memory_n_pages(sweep.requested_memory_n_pages),
+        overprovision_ratio(sweep.overprovision_ratio),
+        memory_alloc(sweep.memory_alloc),
+        counter_dir(sweep.counter_dir),
+        pin_threads(sweep.pin_threads),
+        replica(replica),
+        is_sweep_point(true),
+        n_nodes(sweep.n_nodes),
+        write_sets(sweep.write_sets),
+        write_sets_n_pages(sweep.write_sets_n_pages),
+        max_page_writes(sweep.max_page_writes),
+        sparse_write_sets(sweep.sparse_write_sets),
+        sparse_write_sets_n_pages(sweep.sparse_write_sets_n_pages),
+        write_sets_are_sparse(sweep.write_sets_are_sparse),
+        write_set_runs(sweep.write_set_runs),
+        write_sets_n_runs(sweep.write_sets_n_runs),
+        write_sets_are_runs(sweep.write_sets_are_runs)
+{
+    cell_write_endurances = sweep.cell_write_endurances;
+    std::sort(cell_write_endurances.begin(), cell_write_endurances.end());
+    cell_write_endurances.erase(std::unique(cell_write_endurances.begin(),
+            cell_write_endurances.end()), cell_write_endurances.end());
+
+    cell_write_endurance = cell_write_endurances.back();
 }
 
 Endurer::~Endurer()
 {
-    for (auto& w : write_sets) delete w;
-    for (auto& m : memories) delete m;
+    for (auto& m : memories) munmap(m.total_writes.base, memory_counters_size);
+    for (auto fd : memory_fds) close(fd);
+    for (auto tree : memory_trees) delete tree;
+
+    // let an in-flight checkpoint finish
+    if (checkpoint_writer.joinable()) checkpoint_writer.join();
+    if (checkpoint_snapshot != nullptr)
+        munmap(checkpoint_snapshot, checkpoint_snapshot_size);
+
+    // sweep points only borrow the write sets (and, if any, the thread pool)
+    if (is_sweep_point) return;
+    delete thread_pool;
+    for (size_t i = 0; i < write_sets.size(); ++i) {
+        munmap((void*) write_sets[i], write_sets_n_pages[i] * sizeof(uint64_t));
+    }
+    for (auto sparse_write_set : sparse_write_sets) delete[] sparse_write_set;
+    for (auto runs : write_set_runs) delete[] runs;
+}
+
+static int64_t
+parse_int(const std::string& value)
+{
+    return std::stol(value);
+}
+
+static double
+parse_real(const std::string& value)
+{
+    return std::stod(value);
+}
+
+/*
+ * Parses a comma-separated list of values and/or inclusive START:STOP[:STEP]
+ * ranges (STEP defaults to 1), e.g. "100,1000:5000:1000".
+ */
+template <typename T>
+static std::vector<T>
+parse_values(const std::string& arg, T (*parse_value)(const std::string&))
+{
+    std::vector<T> values;
+    std::stringstream items(arg);
+    std::string item;
+
+    while (std::getline(items, item, ',')) {
+        size_t start_end = item.find(':');
+        if (start_end == std::string::npos) {
+            values.push_back(parse_value(item));
+            continue;
+        }
+        size_t stop_end = item.find(':', start_end + 1);
+
+        T start = parse_value(item.substr(0, start_end));
+        T stop = parse_value(item.substr(start_end + 1,
+                stop_end == std::string::npos ? std::string::npos :
+                stop_end - start_end - 1));
+        T step = stop_end == std::string::npos ? 1 :
+                parse_value(item.substr(stop_end + 1));
+        if (!(step > 0)) {
+            print_message_and_die("range step must be positive: %s",
+                    item.c_str());
+        }
+        if (!(start <= stop)) {
+            print_message_and_die("range start must not exceed its stop: %s",
+                    item.c_str());
+        }
+
+        // each value is computed afresh (not accumulated), so fractional
+        // steps don't drift past the stop value
+        for (T n = 0; start + n * step <= stop; ++n)
+            values.push_back(start + n * step);
+    }
+
+    if (values.empty()) throw std::invalid_argument("no values");
+    return values;
+}
+
+/*
+ * Opens an input file for reading and returns its descriptor, after checking
+ * that it holds a (nonempty) write set, and describing it in info (see
+ * read_write_set_file_info()).
+ */
+static int
+open_input_file(const std::string& filepath, write_set_file_info_t* info)
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd == -1) print_message_and_die("could not open input file");
+
+    // get the file size
+    struct stat input_file_stat;
+    if (fstat(fd, &input_file_stat) != 0)
+        print_message_and_die("could not stat input file");
+    size_t input_file_size = input_file_stat.st_size;
+
+    if (input_file_size == 0)
+        print_message_and_die("input file is empty");
+
+    read_write_set_file_info(fd, input_file_size, info);
+
+    return fd;
 }
 
 void
@@ -26,17 +183,28 @@ Endurer::parse_and_validate_args(int argc, char* argv[])
     int c;
     optind = 0; // global: clear previous getopt() state, if any
     opterr = 0; // global: don't explicitly warn on unrecognized args
-    int n_args_parsed = 0;
+
+    static const struct option long_options[] = {
+        { "replicas", required_argument, nullptr, 'R' },
+        { "lanes", required_argument, nullptr, 'L' },
+        { "checkpoint", required_argument, nullptr, 'C' },
+        { "checkpoint-interval", required_argument, nullptr, 'I' },
+        { "resume", no_argument, nullptr, 'S' },
+        { "fft-batch", required_argument, nullptr, 'F' },
+        { "memory-pages", required_argument, nullptr, 'M' },
+        { "overprovision", required_argument, nullptr, 'O' },
+        { "counter-dir", required_argument, nullptr, 'D' },
+        { nullptr, 0, nullptr, 0 },
+    };
 
     // sentinels
     mode = "";
-    page_size = -1;
-    cell_write_endurance = -1;
-    remap_period = -1;
-
+    counter_bits = 0;
+    n_threads = std::thread::hardware_concurrency();
 
     // parse
-    while ((c = getopt(argc, argv, "m:p:c:r:i:t:")) != -1) {
+    while ((c = getopt_long(argc, argv, "m:p:c:r:i:t:j:w:l:a:P:",
+            long_options, nullptr)) != -1) {
         try {
             switch (c) {
                 case 'm':
@@ -45,13 +213,14 @@ Endurer::parse_and_validate_args(int argc, char* argv[])
                             ::tolower);
                     break;
                 case 'p':
-                    page_size = std::stol(optarg);
+                    page_sizes = parse_values<int64_t>(optarg, parse_int);
                     break;
                 case 'c':
-                    cell_write_endurance = std::stol(optarg);
+                    cell_write_endurances = parse_values<int64_t>(optarg,
+                            parse_int);
                     break;
                 case 'r':
-                    remap_period = std::stod(optarg);
+                    remap_periods = parse_values<double>(optarg, parse_real);
                     break;
                 case 'i':
                     input_filepaths.emplace_back(optarg);
@@ -59,6 +228,60 @@ Endurer::parse_and_validate_args(int argc, char* argv[])
                 case 't':
                     input_time_units.emplace_back(std::stod(optarg));
                     break;
+                case 'j':
+                    n_threads = std::stoul(optarg);
+                    break;
+                case 'R':
+                    n_replicas = std::stoul(optarg);
+                    break;
+                case 'L':
+                    n_lanes = std::stoul(optarg);
+                    break;
+                case 'C':
+                    checkpoint_path = optarg;
+                    break;
+                case 'I':
+                    checkpoint_interval = std::stod(optarg);
+                    break;
+                case 'S':
+                    resume = true;
+                    break;
+                case 'F':
+                    fft_batch_periods = std::stoul(optarg);
+                    break;
+                case 'M':
+                    requested_memory_n_pages = std::stoull(optarg);
+                    break;
+                case 'O':
+                    overprovision_ratio = std::stod(optarg);
+                    if (overprovision_ratio < 0)
+                        print_message_and_die("overprovision ratio must be "
+                                "non-negative: <--overprovision RATIO>");
+                    break;
+                case 'D':
+                    counter_dir = optarg;
+                    break;
+                case 'w':
+                    counter_bits = std::stoul(optarg);
+                    break;
+                case 'l':
+                    if (strcmp(optarg, "populate") == 0) populate_inputs = true;
+                    else if (strcmp(optarg, "hugepage") == 0)
+                        hugepage_inputs = true;
+                    else if (strcmp(optarg, "direct") == 0)
+                        direct_inputs = true;
+                    else print_message_and_die("input load hint must be "
+                            "'populate', 'hugepage', or 'direct': <-l HINT>");
+                    break;
+                case 'a':
+                    memory_alloc = optarg;
+                    break;
+                case 'P':
+                    if (strcmp(optarg, "on") == 0) pin_threads = true;
+                    else if (strcmp(optarg, "off") == 0) pin_threads = false;
+                    else print_message_and_die("thread pinning must be 'on' "
+                            "or 'off': <-P on|off>");
+                    break;
                 case '?':
                     print_message_and_die("unrecognized argument");
             }
@@ -66,135 +289,634 @@ Endurer::parse_and_validate_args(int argc, char* argv[])
         catch (...) {
             print_message_and_die("generic arg parse failure");
         }
-        ++n_args_parsed;
     }
 
     // and validate
-    // the executable itself (1) plus each arg matched w/its preceding flag (*2)
-    int argc_expected = 1 + (2 * n_args_parsed);
-    if (argc != argc_expected)
+    // every short option takes a value, so anything left over lacks a flag
+    if (optind != argc)
             print_message_and_die("each argument must be accompanied by a "
             "flag");
 
     if (mode != "time" and mode != "write" and mode != "lifetime")
         print_message_and_die("mode must be either 'time', 'write', or "
                 "'lifetime': <-m MODE>");
-    if (page_size == -1)
+    if (input_filepaths.size() == 0)
+            print_message_and_die("must supply input file(s): <-i INPUT_FILE>"
+            " [-i INPUT_FILE]...");
+
+    // self-describing input files stand in for -p and -t, and otherwise
+    // must agree with them (but for a sweep over page sizes)
+    input_files_info.resize(input_filepaths.size());
+    bool input_files_have_time_units = true;
+    for (size_t i = 0; i < input_filepaths.size(); ++i) {
+        auto& info = input_files_info[i];
+        close(open_input_file(input_filepaths[i], &info));
+
+        if (info.page_size != 0 and page_sizes.empty())
+            page_sizes.push_back(info.page_size);
+        else if (info.page_size != 0 and page_sizes.size() == 1 and
+                page_sizes[0] != info.page_size)
+            print_message_and_die("input file %s was recorded with page size "
+                    "%zd: <-p PAGE_SIZE>", input_filepaths[i].c_str(),
+                    info.page_size);
+
+        if (info.time_units == 0) input_files_have_time_units = false;
+        if (info.time_units != 0 and i < input_time_units.size() and
+                input_time_units[i] != info.time_units)
+            print_message_and_die("input file %s was recorded with time units "
+                    "%g: <-t TIME_UNITS>", input_filepaths[i].c_str(),
+                    info.time_units);
+    }
+    if (input_time_units.size() == 0 and input_files_have_time_units) {
+        for (auto& info : input_files_info)
+            input_time_units.push_back(info.time_units);
+    }
+
+    if (page_sizes.empty())
         print_message_and_die("must supply page size: <-p PAGE_SIZE>");
-    if (cell_write_endurance == -1)
+    if (cell_write_endurances.empty())
         print_message_and_die("must supply cell write endurance: <-c ENDU>");
-    if (mode != "lifetime" and remap_period == -1)
+    if (mode != "lifetime" and remap_periods.empty())
         print_message_and_die("must supply remap period (in time units or "
                 "write units, depending on mode): <-r PERIOD>");
-    if (input_filepaths.size() == 0)
-            print_message_and_die("must supply input file(s): <-i INPUT_FILE>"
-            " [-i INPUT_FILE]...");
+    if (mode == "lifetime" and (is_sweep() or n_replicas != 1))
+        print_message_and_die("lifetime mode takes a single page size and "
+                "endurance, and no replicas");
     if (input_time_units.size() == 0)
             print_message_and_die("must supply input time units (in "
             "instructions/cycles/seconds): <-t TIME_UNITS> [-t TIME_UNITS]...");
     if (input_filepaths.size() != input_time_units.size())
             print_message_and_die("must specify an indentical number of input"
             " files (-i) and input time units (-t)");
+    if (counter_bits != 0 and counter_bits != 32 and counter_bits != 64)
+        print_message_and_die("counter width must be 32 or 64 bits (or "
+                "omitted, to pick automatically): <-w COUNTER_BITS>");
+    if (memory_alloc != "thp" and memory_alloc != "hugetlb" and
+            memory_alloc != "none")
+        print_message_and_die("node memory allocation must be 'thp', "
+                "'hugetlb', or 'none': <-a ALLOC>");
+    if (n_threads == 0)
+        print_message_and_die("number of threads must be positive: "
+                "<-j N_THREADS>");
+    if (n_replicas == 0)
+        print_message_and_die("number of replicas must be positive: "
+                "<--replicas N_REPLICAS>");
+    if (n_lanes == 0)
+        print_message_and_die("number of lanes must be positive: "
+                "<--lanes N_LANES>");
+    if (resume and checkpoint_path.empty())
+        print_message_and_die("must supply the checkpoint to resume from: "
+                "<--checkpoint FILE>");
+    if (!checkpoint_path.empty() and (mode == "lifetime" or is_sweep() or
+            n_replicas != 1))
+        print_message_and_die("checkpoints are only supported for single "
+                "write or time runs");
+    if (n_lanes != 1 and !is_sweep() and n_replicas == 1)
+        print_message_and_die("lanes are only supported for sweeps or "
+                "replicas: <--lanes N_LANES>");
+    if (fft_batch_periods != 0 and (mode == "lifetime" or n_lanes != 1))
+        print_message_and_die("FFT batches are only supported for write or "
+                "time runs without <--lanes N_LANES>");
+    if (requested_memory_n_pages != 0 and overprovision_ratio >= 0)
+        print_message_and_die("must supply at most one memory size: "
+                "<--memory-pages N_PAGES> or <--overprovision RATIO>");
+    // (checkpoint snapshots and FFT batches keep whole node memories' worth
+    // of data in RAM)
+    if (!counter_dir.empty() and (!checkpoint_path.empty() or
+            fft_batch_periods != 0 or memory_alloc == "hugetlb"))
+        print_message_and_die("out-of-core node memories don't support "
+                "checkpoints, FFT batches, or hugetlb pages: "
+                "<--counter-dir DIR>");
 
 
     n_nodes = input_filepaths.size();
+
+    // the values used by a single (non-sweep) run
+    page_size = page_sizes[0];
+    cell_write_endurance = cell_write_endurances[0];
+    remap_period = remap_periods.empty() ? -1 : remap_periods[0];
+}
+
+/*
+ * Whether -p, -c, or -r was given more than one value.
+ */
+bool
+Endurer::is_sweep()
+{
+    return page_sizes.size() > 1 or cell_write_endurances.size() > 1 or
+            remap_periods.size() > 1;
 }
 
 void
 Endurer::run()
 {
-    read_input_files();
-    create_node_memories();
-
-    if (mode == "write") do_sim_write();
-#if 0
-    else if (mode == "time") do_sim_time();
-    else if (mode == "lifetime") do_sim_lifetime();
-#endif
-    else print_message_and_die("NYI: mode unsupported");
+    if (mode == "lifetime") {
+        // streams the input files itself, and needs no node memories (only
+        // their size, for the stats)
+        do_sim_lifetime();
+        size_node_memories();
+    }
+    else if (is_sweep() or n_replicas != 1) {
+        // prints its own table of stats
+        read_input_files();
+        do_sweep();
+        return;
+    }
+    else {
+        read_input_files();
+        create_node_memories();
+        do_sim_remapped();
+    }
 
     print_stats();
 }
 
+/*
+ * Allocates a zero-filled anonymous buffer of at least the given size, aligned
+ * to (and so backable by) transparent hugepages.
+ */
+void*
+Endurer::map_hugepage_buffer(size_t size)
+{
+    // over-map by a hugepage, then trim down to the aligned part
+    size_t aligned_size = (size + OS_PAGE_SIZE - 1) & ~(OS_PAGE_SIZE - 1);
+    size_t mapping_size = aligned_size + HUGE_PAGE_SIZE;
+    void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED)
+        print_message_and_die("could not allocate input buffer");
+
+    uintptr_t first = (uintptr_t) mapping;
+    uintptr_t aligned_first = (first + HUGE_PAGE_SIZE - 1) &
+            ~(HUGE_PAGE_SIZE - 1);
+    uintptr_t end = first + mapping_size;
+    if (aligned_first != first) munmap(mapping, aligned_first - first);
+    if (aligned_first + aligned_size != end) {
+        munmap((void*) (aligned_first + aligned_size),
+                end - (aligned_first + aligned_size));
+    }
+
+    madvise((void*) aligned_first, aligned_size, MADV_HUGEPAGE);
+    return (void*) aligned_first;
+}
+
+/*
+ * Loads the input files. By default, they are mapped read-only, and write sets
+ * are read straight out of the mappings (and so out of the page cache), never
+ * copied; the kernel is asked to start reading each block ahead of its scan.
+ * "-l populate" instead faults each file in whole up front, and
+ * "-l hugepage" asks for (read-only, file-backed) transparent hugepages
+ * where the kernel supports them. "-l direct" instead reads the files with
+ * O_DIRECT, bypassing the page cache, into hugepage-aligned anonymous
+ * buffers.
+ * Either way, the files are loaded LOAD_BLOCK_N_PAGES at a time, by all
+ * threads at once: the blocks of all files are interleaved, so every file
+ * (and so every drive it may be on) has reads in flight together, and each
+ * block's statistics are gathered as soon as it is in, while others are still
+ * being read. Each file's load time and throughput is reported (to stderr).
+ */
 void
 Endurer::read_input_files()
 {
-    // need these b/c we pull references out for individual vector elements
-    write_sets_n_pages.reserve(input_filepaths.size());
-    write_sets.reserve(input_filepaths.size());
+    size_t n_files = input_filepaths.size();
 
-    for (size_t i = 0; i < input_filepaths.size(); ++i) {
+    // need these b/c we pull references out for individual vector elements
+    write_sets_n_pages.resize(n_files);
+    write_sets.resize(n_files);
+    sparse_write_sets.resize(n_files);
+    sparse_write_sets_n_pages.resize(n_files);
+    write_sets_are_sparse.resize(n_files);
+    write_set_runs.resize(n_files);
+    write_sets_n_runs.resize(n_files);
+    std::vector<uint64_t> write_sets_n_nonzero_pages(n_files);
+
+    std::vector<int> fds(n_files, -1);
+    std::vector<std::vector<uint64_t>> files_checksums(n_files);
+    for (size_t i = 0; i < n_files; ++i) {
         auto& filepath = input_filepaths[i];
-        auto& write_set = write_sets[i];
-        auto& write_set_n_pages = write_sets_n_pages[i];
+        auto& info = input_files_info[i];
+
+        int fd = open_input_file(filepath, &info);
+        write_sets_n_pages[i] = info.n_pages;
+        size_t input_file_size = info.n_pages * sizeof(uint64_t);
+        files_checksums[i] = read_write_set_checksums(fd, info);
+
+        if (direct_inputs) {
+            // (not every filesystem supports O_DIRECT; fall back to the page
+            // cache on those)
+            close(fd);
+            fd = open(filepath.c_str(), O_RDONLY | O_DIRECT);
+            if (fd == -1) {
+                print_warning("could not open %s for direct I/O; reading it "
+                        "through the page cache", filepath.c_str());
+                fd = open(filepath.c_str(), O_RDONLY);
+                if (fd == -1)
+                    print_message_and_die("could not open input file");
+            }
+            fds[i] = fd;
+            write_sets[i] = (const uint64_t*) map_hugepage_buffer(
+                    input_file_size);
+            continue;
+        }
+
+        // map the file's write set (which starts on a page boundary); the
+        // mapping outlives the descriptor
+        int map_flags = MAP_PRIVATE | (populate_inputs ? MAP_POPULATE : 0);
+        void* mapping = mmap(nullptr, input_file_size, PROT_READ, map_flags,
+                fd, info.payload_offset);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            print_message_and_die("could not map input file");
+
+        if (hugepage_inputs) madvise(mapping, input_file_size, MADV_HUGEPAGE);
+
+        write_sets[i] = (const uint64_t*) mapping;
+    }
+
+    // the blocks of all files, round-robin across them
+    typedef struct {
+        uint32_t file;
+        uint64_t first_page;
+    } load_block_t;
+    std::vector<load_block_t> blocks;
+    std::vector<uint64_t> files_n_blocks_left(n_files);
+    for (uint64_t first_page = 0; ; first_page += LOAD_BLOCK_N_PAGES) {
+        size_t n_blocks = blocks.size();
+        for (uint32_t i = 0; i < n_files; ++i) {
+            if (first_page >= write_sets_n_pages[i]) continue;
+            blocks.push_back({ i, first_page });
+            ++files_n_blocks_left[i];
+        }
+        if (blocks.size() == n_blocks) break;
+    }
+
+    // per block: largest entry, nonzero entries, and runs (counting one
+    // starting at the block's first entry; see below)
+    std::vector<uint64_t> blocks_max_writes(blocks.size());
+    std::vector<uint64_t> blocks_n_nonzero_pages(blocks.size());
+    std::vector<uint64_t> blocks_n_runs(blocks.size());
+    std::vector<std::atomic<uint64_t>> files_n_blocks_pending(n_files);
+    for (size_t i = 0; i < n_files; ++i)
+        files_n_blocks_pending[i] = files_n_blocks_left[i];
+    std::vector<double> files_load_seconds(n_files);
+    auto load_start_time = std::chrono::steady_clock::now();
+
+    auto load_block = [&](size_t block) {
+        uint32_t i = blocks[block].file;
+        uint64_t first_page = blocks[block].first_page;
+        uint64_t block_n_pages = MIN(LOAD_BLOCK_N_PAGES,
+                write_sets_n_pages[i] - first_page);
+        const uint64_t* entries = write_sets[i] + first_page;
+        size_t block_size = block_n_pages * sizeof(uint64_t);
+
+        // (the buffer is page-rounded, so has room for the last block's
+        // O_DIRECT transfer rounded up)
+        if (direct_inputs and !pread_all_direct(fds[i], (void*) entries,
+                block_size, input_files_info[i].payload_offset +
+                first_page * sizeof(uint64_t)))
+            print_message_and_die("could not read input file");
+        else if (!populate_inputs) {
+            madvise((void*) entries, block_size, MADV_WILLNEED);
+        }
+
+        // (checksum blocks are no larger than load blocks, and both powers
+        // of two, so each load block holds whole checksum blocks)
+        check_write_set_block(input_filepaths[i].c_str(), input_files_info[i],
+                files_checksums[i], entries, first_page, block_n_pages);
+
+        uint64_t max_writes = 0;
+        uint64_t n_nonzero_pages = 0;
+        uint64_t n_runs = 1;
+        for (size_t j = 0; j < block_n_pages; ++j) {
+            max_writes = MAX(max_writes, entries[j]);
+            if (entries[j] != 0) ++n_nonzero_pages;
+            if (j != 0 and entries[j] != entries[j - 1]) ++n_runs;
+        }
+        blocks_max_writes[block] = max_writes;
+        blocks_n_nonzero_pages[block] = n_nonzero_pages;
+        blocks_n_runs[block] = n_runs;
+
+        if (--files_n_blocks_pending[i] == 0) {
+            std::chrono::duration<double> load_time =
+                    std::chrono::steady_clock::now() - load_start_time;
+            files_load_seconds[i] = load_time.count();
+        }
+    };
+    if (thread_pool == nullptr) {
+        for (size_t block = 0; block < blocks.size(); ++block)
+            load_block(block);
+    }
+    else thread_pool->parallel_for_dynamic(blocks.size(), load_block);
+
+    for (size_t block = 0; block < blocks.size(); ++block) {
+        uint32_t i = blocks[block].file;
+        uint64_t first_page = blocks[block].first_page;
+
+        max_page_writes = MAX(max_page_writes, blocks_max_writes[block]);
+        write_sets_n_nonzero_pages[i] += blocks_n_nonzero_pages[block];
+        write_sets_n_runs[i] += blocks_n_runs[block];
+
+        // a run carried over from the previous block was counted twice
+        const uint64_t* write_set = write_sets[i];
+        if (first_page != 0 and write_set[first_page] ==
+                write_set[first_page - 1])
+            --write_sets_n_runs[i];
+    }
 
-        size_t input_file_size;
+    for (size_t i = 0; i < n_files; ++i) {
+        if (fds[i] != -1) close(fds[i]);
 
-        std::ifstream ifs(filepath, std::ios::binary);
-        if (!ifs.is_open()) print_message_and_die("could not open input file");
+        double gib = (double) (write_sets_n_pages[i] * sizeof(uint64_t)) /
+                (1024 * 1024 * 1024);
+        fprintf(stderr, "loaded %s: %f GiB in %f s (%f GiB/s)\n",
+                input_filepaths[i].c_str(), gib, files_load_seconds[i],
+                gib / files_load_seconds[i]);
+    }
 
-        // get the file size
-        ifs.seekg(0, std::ios::end);
-        input_file_size = ifs.tellg();
-        ifs.seekg(0, std::ios::beg);
+    // if every write set is blocky (long runs of equal entries), they are
+    // kept as lists of their runs, and node memories as range trees, so that
+    // a pass costs a few tree operations per run rather than one per page
+    // (see apply_write_set_runs()). FFT batches, lanes, and checkpoints work
+    // on page counters, and out-of-core memories need them (range trees are
+    // kept in RAM), so they rule this out.
+    write_sets_are_runs = fft_batch_periods == 0 and n_lanes == 1 and
+            checkpoint_path.empty() and counter_dir.empty();
+    for (size_t i = 0; i < n_files; ++i) {
+        double run_density = (double) write_sets_n_runs[i] /
+                (double) write_sets_n_pages[i];
+        if (run_density >= RUN_DENSITY_THRESHOLD) write_sets_are_runs = false;
+    }
 
-        if (input_file_size % sizeof(uint64_t) != 0)
-                print_message_and_die("malformed input file; its size should be"
-                " a multiple of %zu", sizeof(uint64_t));
+    auto convert_write_set = [&](size_t i) {
+        auto& write_set = write_sets[i];
+        auto& write_set_n_pages = write_sets_n_pages[i];
+        uint64_t write_set_n_nonzero_pages = write_sets_n_nonzero_pages[i];
 
-        write_set_n_pages = input_file_size / sizeof(uint64_t);
+        if (write_sets_are_runs) {
+            auto runs = new write_run_t[write_sets_n_runs[i]];
 
-        // allocate the application-side vector
-        write_set = new uint64_t[write_set_n_pages];
+            uint64_t n_runs = 0;
+            for (size_t j = 0; j < write_set_n_pages; ++j) {
+                if (j == 0 or write_set[j] != write_set[j - 1])
+                    runs[n_runs++] = { j, write_set[j] };
+            }
+            write_set_runs[i] = runs;
+            return;
+        }
 
-        // copy the contents from the file
-        ifs.read((char*) write_set, input_file_size);
+        // mostly-zero write sets are also kept as a list of their nonzero
+        // pages, so that they can be applied without walking the zeros
+        double density = (double) write_set_n_nonzero_pages /
+                (double) write_set_n_pages;
+        if (density < SPARSE_DENSITY_THRESHOLD) {
+            auto sparse_write_set =
+                    new sparse_page_t[write_set_n_nonzero_pages];
+
+            uint64_t n_entries = 0;
+            for (size_t j = 0; j < write_set_n_pages; ++j) {
+                if (write_set[j] != 0)
+                    sparse_write_set[n_entries++] = { j, write_set[j] };
+            }
+            sparse_write_sets[i] = sparse_write_set;
+            sparse_write_sets_n_pages[i] = write_set_n_nonzero_pages;
+            write_sets_are_sparse[i] = true;
+        }
+    };
+    if (thread_pool == nullptr) {
+        for (size_t i = 0; i < n_files; ++i) convert_write_set(i);
     }
+    else thread_pool->parallel_for_dynamic(n_files, convert_write_set);
 }
 
 
 /*
- * For simulation purposes, create a memory that is the next-power-of-two
+ * For simulation purposes, size a memory that is the next-power-of-two
  * larger than the size of the write set (unless it is already a perfect power
  * of two; then, just make it that exact size).
  * For multiple nodes, the memory size used across all of them will be the
  * largest required by any individual write set.
+ * Alternatively, the size may be given outright ("--memory-pages"), or as the
+ * largest write set plus a ratio of overprovisioning ("--overprovision");
+ * neither needs to be a power of two.
  */
 void
-Endurer::create_node_memories()
+Endurer::size_node_memories()
 {
     // find a common size for all memories (greatest of any needed)
     for (size_t i = 0; i < n_nodes; ++i) {
         auto& write_set_n_pages = write_sets_n_pages[i];
 
-        // find the next highest power-of-two
-        size_t write_set_msb_bit_pos = ((8 * sizeof(uint64_t)) - 1) -
+        // find the next highest power-of-two (all in 64 bits: memories may
+        // well exceed 2^32 pages)
+        uint64_t write_set_msb_bit_pos = ((8 * sizeof(uint64_t)) - 1) -
                 __builtin_clzl(write_set_n_pages);
         bool write_set_is_power_of_two =
-                __builtin_popcount(write_set_n_pages) == 1;
+                __builtin_popcountl(write_set_n_pages) == 1;
 
-        size_t memory_n_pages_log2 = write_set_is_power_of_two ?
+        uint64_t memory_n_pages_log2 = write_set_is_power_of_two ?
                 write_set_msb_bit_pos : write_set_msb_bit_pos + 1;
-        size_t memory_n_pages = 1 << memory_n_pages_log2;
+        uint64_t memory_n_pages = (uint64_t) 1 << memory_n_pages_log2;
 
         this->memory_n_pages = MAX(this->memory_n_pages, memory_n_pages);
     }
 
-    // now that we've agreed upon a standard size for all node memories,
-    // allocate them.
-    memories.reserve(n_nodes);
-    for (size_t i = 0; i < n_nodes; ++i) {
-        auto& memory = memories[i];
-        memory = new mem_t[memory_n_pages];
+    uint64_t max_write_set_n_pages = *std::max_element(
+            write_sets_n_pages.begin(), write_sets_n_pages.end());
+    if (requested_memory_n_pages != 0) {
+        memory_n_pages = requested_memory_n_pages;
+        if (memory_n_pages < max_write_set_n_pages)
+            print_message_and_die("memory must hold the largest write set "
+                    "(%zu pages): <--memory-pages N_PAGES>",
+                    max_write_set_n_pages);
+    }
+    else if (overprovision_ratio >= 0) {
+        memory_n_pages = std::ceil(max_write_set_n_pages *
+                (1 + overprovision_ratio));
+    }
+}
 
-        // zero the memory counters
-        for (size_t j = 0; j < memory_n_pages; ++j) memory[j] = { 0, 0 };
+/*
+ * Creates an unnamed file of the given size in the given directory, and
+ * returns its descriptor. The file is sparse, so reads as all zeros and takes
+ * up no disk until written, and is deleted once closed.
+ */
+static int
+create_counter_file(const std::string& dir, size_t size)
+{
+    int fd = open(dir.c_str(), O_TMPFILE | O_RDWR, 0600);
+    if (fd == -1) {
+        // (not every filesystem supports O_TMPFILE)
+        std::string path = dir + "/endurer-counters-XXXXXX";
+        fd = mkstemp(&path[0]);
+        if (fd != -1) unlink(path.c_str());
     }
+    if (fd == -1)
+        print_message_and_die("could not create counter file in %s",
+                dir.c_str());
+    if (ftruncate(fd, size) != 0)
+        print_message_and_die("could not size counter file in %s",
+                dir.c_str());
+
+    return fd;
+}
+
+/*
+ * Allocates the node memories, once the write sets have been read.
+ */
+void
+Endurer::create_node_memories()
+{
+    size_node_memories();
 
     // set up the PRNG and distribution here, as we range from [0, mem size)
     rand_gen.seed(RAND_SEED);
     decltype(rand_dist.param()) range(0, memory_n_pages - 1);
     rand_dist.param(range);
+
+    // use 32-bit counters if no counter can ever exceed that range. stored
+    // counters stay below the endurance between passes, and a single pass
+    // adds at most MAX(endurance, max_page_writes) to any of them (see
+    // start_sim()). otherwise, promote to 64 bits.
+    uint64_t endurance = cell_write_endurance;
+    bool counters_fit_narrow = endurance <= UINT32_MAX and
+            max_page_writes <= UINT32_MAX and
+            endurance + MAX(endurance, max_page_writes) <= UINT32_MAX;
+
+    if (counter_bits == 0) counter_bits = counters_fit_narrow ? 32 : 64;
+    if (counter_bits == 32 and !counters_fit_narrow)
+        print_message_and_die("32-bit counters could overflow with this "
+                "endurance and these write sets; use <-w 64>");
+
+    // blocky write sets: a range tree per node memory, each node a single
+    // unit of parallel work (until the trees outgrow page counters; see
+    // move_memory_trees_to_counters())
+    if (write_sets_are_runs) {
+        n_chunks_per_node = 1;
+        for (uint32_t i = 0; i < n_nodes; ++i)
+            memory_trees.push_back(new RangeMaxTree(memory_n_pages));
+        return;
+    }
+
+    create_node_counters();
+}
+
+/*
+ * Allocates the node memories' page counters, once their size and width have
+ * been settled.
+ */
+void
+Endurer::create_node_counters()
+{
+    n_chunks_per_node = (memory_n_pages + CHUNK_N_PAGES - 1) / CHUNK_N_PAGES;
+
+    // now that we've agreed upon a standard size for all node memories,
+    // allocate them as anonymous mappings (which are page-aligned, so each
+    // counter array is also cache-line aligned), backed by transparent
+    // hugepages ("-a thp"), reserved hugetlbfs pages ("-a hugetlb"), or
+    // neither ("-a none"). out of core ("--counter-dir"), they are instead
+    // shared mappings of sparse files in the given directory, paged in and
+    // out by the kernel (see advise_counter_window()).
+    bool use_hugetlb = memory_alloc == "hugetlb";
+    size_t alloc_granularity = use_hugetlb ? HUGE_PAGE_SIZE : OS_PAGE_SIZE;
+
+    memory_counters_size = memory_n_pages * (counter_bits / 8);
+    memory_counters_size = (memory_counters_size + alloc_granularity - 1) &
+            ~(alloc_granularity - 1);
+
+    // a write set lands on a fresh part of a memory much larger than it
+    // with every remap, faulting in a whole hugepage for each 4 KiB it
+    // touches; keep to base pages then
+    uint64_t max_write_set_n_pages = *std::max_element(
+            write_sets_n_pages.begin(), write_sets_n_pages.end());
+    bool use_thp = memory_alloc == "thp" and
+            memory_n_pages <= THP_MAX_MEMORY_OVER_WRITE_SET *
+            max_write_set_n_pages;
+
+    memories.resize(n_nodes);
+    for (size_t i = 0; i < n_nodes; ++i) {
+        auto& memory = memories[i];
+
+        // (hugetlb pages are reserved up front, so a shortage fails here
+        // rather than as a SIGBUS on first touch)
+        int fd = -1;
+        int map_flags = MAP_PRIVATE | MAP_ANONYMOUS |
+                (use_hugetlb ? MAP_HUGETLB : MAP_NORESERVE);
+        if (!counter_dir.empty()) {
+            fd = create_counter_file(counter_dir, memory_counters_size);
+            memory_fds.push_back(fd);
+            map_flags = MAP_SHARED;
+        }
+
+        void* mapping = mmap(nullptr, memory_counters_size,
+                PROT_READ | PROT_WRITE, map_flags, fd, 0);
+        if (mapping == MAP_FAILED) {
+            print_message_and_die("could not allocate node memory%s",
+                    use_hugetlb ? " (are enough hugetlb pages reserved?)" : "");
+        }
+        if (use_thp and fd == -1)
+            madvise(mapping, memory_counters_size, MADV_HUGEPAGE);
+
+        memory.total_writes.base = mapping;
+        memory.total_writes.is_narrow = counter_bits == 32;
+    }
+
+    // the mappings are zero-filled lazily, on first touch, and are left to
+    // be: a chunk is only ever written by the thread that owns it (see
+    // find_write_set_chunks()), so its pages are local to that thread's NUMA
+    // node all the same, and parts of a memory no write set ever lands on
+    // (as in a pool much larger than them) never take up RAM. with pinned
+    // threads, owners own whole hugepages, which are placed as a unit;
+    // otherwise (as threads may migrate anyway) single chunks, which balances
+    // small write sets better
+    size_t chunk_size = CHUNK_N_PAGES * (counter_bits / 8);
+    owner_block_n_chunks = 1;
+    if (pin_threads and counter_dir.empty() and (use_thp or use_hugetlb))
+        owner_block_n_chunks = MAX(HUGE_PAGE_SIZE / chunk_size, (size_t) 1);
+}
+
+/*
+ * A range tree gains nodes at every distinct range boundary landed on it, so
+ * with every remap, and in a long run can grow past the size of page counters
+ * for the same memory (48 bytes a page, when full). Once any tree has, every
+ * node memory is moved onto page counters holding the same values, and the
+ * run carries on applying write sets page by page; results are unchanged.
+ */
+void
+Endurer::move_memory_trees_to_counters()
+{
+    size_t counters_size = memory_n_pages * (counter_bits / 8);
+    bool trees_outgrown = false;
+    for (auto tree : memory_trees) {
+        if (tree->get_size() > counters_size) trees_outgrown = true;
+    }
+    if (!trees_outgrown) return;
+
+    write_sets_are_runs = false;
+    create_node_counters();
+
+    // (values stay below the endurance between passes, so fit the counters;
+    // each chunk is filled in by its owner, which so first touches it)
+    parallel_for_node_chunks(n_nodes, [&](uint32_t node, uint64_t chunk) {
+        auto& counters = memories[node].total_writes;
+        uint64_t chunk_start = chunk * CHUNK_N_PAGES;
+        uint64_t chunk_end = MIN(chunk_start + CHUNK_N_PAGES, memory_n_pages);
+        memory_trees[node]->for_each_range(chunk_start, chunk_end,
+                [&](uint64_t first, uint64_t end, uint64_t value) {
+            if (value == 0) return;
+
+            if (counters.is_narrow) {
+                std::fill((uint32_t*) counters.base + first,
+                        (uint32_t*) counters.base + end, (uint32_t) value);
+            }
+            else {
+                std::fill((uint64_t*) counters.base + first,
+                        (uint64_t*) counters.base + end, value);
+            }
+        });
+    });
+
+    for (auto tree : memory_trees) delete tree;
+    memory_trees.clear();
 }
 
 /*
@@ -204,167 +926,1721 @@ Endurer::create_node_memories()
 inline uint32_t
 Endurer::get_write_set_idx(uint32_t node_idx)
 {
-    return (node_idx + cluster_node_shift) % n_nodes;
+    // (both are below n_nodes, so no division is needed)
+    uint32_t write_set_idx = node_idx + cluster_node_shift;
+    return write_set_idx >= n_nodes ? write_set_idx - n_nodes : write_set_idx;
+}
+
+/*
+ * Returns the node onto which the given write set is currently mapped (the
+ * inverse of get_write_set_idx()).
+ */
+inline uint32_t
+Endurer::get_node_idx(uint32_t write_set_idx)
+{
+    uint32_t node_idx = write_set_idx + n_nodes - cluster_node_shift;
+    return node_idx >= n_nodes ? node_idx - n_nodes : node_idx;
+}
+
+/*
+ * Returns the stored total_writes value at which a page of the given node
+ * reaches the next endurance to be crossed, once its pending remap writes are
+ * folded in.
+ */
+inline uint64_t
+Endurer::get_wearout_threshold(uint32_t node)
+{
+    uint64_t endurance = cell_write_endurances[n_endurances_crossed];
+    uint64_t pending_writes = remap_epochs[node] * EXTRA_WRITES_PER_REMAP;
+
+    return pending_writes >= endurance ? 0 : endurance - pending_writes;
 }
 
 /*
  * For all pages in memory:
  * 1. adds EXTRA_WRITES_PER_REMAP to total_writes.
- * 2. resets period_writes to 0.
+ * 2. resets the period (see get_iterations_per_remap()).
  * 3. generates a new offset.
+ * The first is done lazily: each node's remap epoch counts the
+ * EXTRA_WRITES_PER_REMAP still pending on every one of its pages (see
+ * get_wearout_threshold()).
  */
 void
 Endurer::do_remap()
 {
-    // bump write counter for all pages in all node memories
-    for (uint32_t i = 0; i < n_nodes; ++i) {
-        auto& memory = memories[i];
-
-        for (size_t j = 0; j < memory_n_pages; ++j) {
-            memory[j].total_writes += EXTRA_WRITES_PER_REMAP;
-            memory[j].period_writes = 0;
-        }
-    }
+    for (uint32_t i = 0; i < n_nodes; ++i) ++remap_epochs[i];
+    period_iterations = 0;
 
-    // remap within all nodes
+    // remap within all nodes. replicas each draw from their own
+    // counter-based stream, indexed by (remap, node)
     for (size_t i = 0; i < n_nodes; ++i) {
-        intra_node_offsets[i] = rand_dist(rand_gen);
+        if (replica == NO_REPLICA) intra_node_offsets[i] = rand_dist(rand_gen);
+        else {
+            uint64_t key = ((uint64_t) replica << 32) | RAND_SEED;
+            intra_node_offsets[i] = philox_bounded(n_remaps, i, key,
+                    memory_n_pages);
+        }
     }
     // round-robin amongst cluster nodes
     cluster_node_shift = (cluster_node_shift + 1) % n_nodes;
 
+    // write sets now land on other pages, of which only the node-wide bound
+    // is known
+    nodes_mapped_max_writes = nodes_max_writes;
+
     ++n_remaps;
 }
 
 /*
- * Write-triggered simulation mode.
+ * Returns the smallest k >= 1 for which k * step reaches target, or UINT64_MAX
+ * if no such k exists.
  */
-void
-Endurer::do_sim_write()
+static uint64_t
+get_n_steps_to_reach(double target, double step)
 {
-    // resize(), not reserve! we need these to have default values (0) initially
-    intra_node_offsets.resize(n_nodes);
-    runtimes.resize(n_nodes);
+    if (target <= 0) return 1;
+    if (step <= 0) return UINT64_MAX;
 
-    // outer loop: iterate through all nodes and apply write sets to them
-    // until one triggers a remap
-    bool should_terminate = false;
-    while (!should_terminate) {
+    double n_steps_approx = std::ceil(target / step);
+    if (n_steps_approx >= (double) UINT64_MAX / step) return UINT64_MAX;
 
-        bool should_remap = false;
-        for (size_t node = 0; node < n_nodes; ++node) {
-            // node-related variables
-            auto& intra_node_offset = intra_node_offsets[node];
-            auto& memory = memories[node];
-            auto& runtime = runtimes[node];
+    // correct for any rounding in the division above
+    uint64_t n_steps = MAX((uint64_t) n_steps_approx, (uint64_t) 1);
+    while (n_steps > 1 && (double) (n_steps - 1) * step >= target) --n_steps;
+    while ((double) n_steps * step < target) ++n_steps;
 
-            // write-set-related variables
-            uint32_t write_set_idx = get_write_set_idx(node);
-            auto& write_set = write_sets[write_set_idx];
-            auto& write_set_n_pages = write_sets_n_pages[write_set_idx];
-            auto& input_time = input_time_units[write_set_idx];
+    return n_steps;
+}
 
+/*
+ * Returns the number of whole iterations after which a remap is triggered.
+ * Either trigger only depends on the iterations since the last remap, so no
+ * per-page period writes or running timers are kept:
+ * - write mode: a page's period writes are the iterations times the write-set
+ *   entry mapped onto it, so the largest entry is the first to reach the
+ *   period.
+ * - time mode: each node's timer is the iterations times the time units of the
+ *   input mapped onto it, so the longest-running input is the first to reach
+ *   the period.
+ * The cluster shift only permutes write sets amongst nodes, so this is the
+ * same for every remap period of a run.
+ */
+uint64_t
+Endurer::get_iterations_per_remap()
+{
+    if (mode == "write")
+        return get_n_steps_to_reach(remap_period, max_page_writes);
+
+    uint64_t n_iters = UINT64_MAX;
+    for (double time_units : input_time_units) {
+        uint64_t input_n_iters = get_n_steps_to_reach(remap_period,
+                time_units);
+        n_iters = MIN(n_iters, input_n_iters);
+    }
 
-            // inner loop: apply page writes to individual pages
-            for (size_t page = 0; page < write_set_n_pages; ++page) {
-                uint64_t new_writes = write_set[page];
+    return n_iters;
+}
 
-                size_t mem_idx = (page + intra_node_offset) % memory_n_pages;
+/*
+ * A node's write set lands on its memory starting at the intra-node offset,
+ * wrapping around the end of memory: write-set pages [0, n_head) map to memory
+ * pages [offset, offset + n_head), and the remainder to [0, n_pages - n_head).
+ * Calls fn(mem_idx, page, n_pages) for each (at most two) contiguous range of
+ * that mapping falling within the given chunk of node memory.
+ */
+template <typename F>
+inline void
+Endurer::for_each_write_set_range(uint32_t node, uint64_t chunk, F fn)
+{
+    uint64_t intra_node_offset = intra_node_offsets[node];
+    uint64_t write_set_n_pages = write_sets_n_pages[get_write_set_idx(node)];
 
-                memory[mem_idx].period_writes += new_writes;
-                memory[mem_idx].total_writes += new_writes;
+    uint64_t n_head_pages = MIN(write_set_n_pages,
+            memory_n_pages - intra_node_offset);
+    uint64_t n_tail_pages = write_set_n_pages - n_head_pages;
 
-                if (memory[mem_idx].period_writes >= remap_period) {
-                    should_remap = true;
-                }
+    uint64_t chunk_start = chunk * CHUNK_N_PAGES;
+    uint64_t chunk_end = MIN(chunk_start + CHUNK_N_PAGES, memory_n_pages);
 
-                if (memory[mem_idx].total_writes >= cell_write_endurance) {
-                    should_terminate = true;
-                }
-            }
+    // head: memory pages [offset, offset + n_head)
+    uint64_t head_start = MAX(chunk_start, intra_node_offset);
+    uint64_t head_end = MIN(chunk_end, intra_node_offset + n_head_pages);
+    if (head_start < head_end) {
+        fn(head_start, head_start - intra_node_offset, head_end - head_start);
+    }
 
-            runtime += input_time;
+    // tail: memory pages [0, n_tail)
+    uint64_t tail_end = MIN(chunk_end, n_tail_pages);
+    if (chunk_start < tail_end) {
+        fn(chunk_start, n_head_pages + chunk_start, tail_end - chunk_start);
+    }
+}
 
-            if (should_terminate) break;
+/*
+ * Out-of-core node memories are worked through a window of
+ * COUNTER_WINDOW_N_CHUNKS chunks at a time (each thread's share of the chunks
+ * being contiguous): as a thread starts on one window, the kernel is asked to
+ * read in the next (is_write_behind false), and once it is done with one, to
+ * start writing it back (is_write_behind true), so that disk I/O overlaps
+ * the simulation and dirty pages can be reclaimed without stalling it. Only
+ * the counters under the node's write set, all that a pass touches, are read
+ * in or written back, in as few contiguous ranges as possible.
+ */
+void
+Endurer::advise_counter_window(uint32_t node, uint64_t first_chunk,
+        bool is_write_behind)
+{
+    size_t counter_size = counter_bits / 8;
+    char* counters = (char*) memories[node].total_writes.base;
+
+    // [first, end) byte range yet to be advised
+    uint64_t range_first = 0;
+    uint64_t range_end = 0;
+    auto advise_range = [&]() {
+        if (range_first == range_end) return;
+        if (is_write_behind) {
+            sync_file_range(memory_fds[node], range_first,
+                    range_end - range_first, SYNC_FILE_RANGE_WRITE);
         }
-
-        if (should_terminate) break;
-        if (should_remap) do_remap();
-        ++n_iterations;
-
-        // print progress
-        if (n_iterations % 5 == 0) {
-            double avg_runtime = std::accumulate(runtimes.begin(),
-                    runtimes.end(), 0.0) / runtimes.size();
-            printf("At %zu iterations: %zu remaps; avg. runtime %f\n",
-                    n_iterations, n_remaps, avg_runtime);
+        else {
+            uint64_t aligned_first = range_first & ~(OS_PAGE_SIZE - 1);
+            madvise(counters + aligned_first, range_end - aligned_first,
+                    MADV_WILLNEED);
         }
+    };
+
+    uint64_t end_chunk = MIN(first_chunk + COUNTER_WINDOW_N_CHUNKS,
+            n_chunks_per_node);
+    for (uint64_t chunk = first_chunk; chunk < end_chunk; ++chunk) {
+        for_each_write_set_range(node, chunk, [&](uint64_t mem_idx,
+                uint64_t, uint64_t n_pages) {
+            uint64_t first = mem_idx * counter_size;
+            if (first != range_end) {
+                advise_range();
+                range_first = first;
+            }
+            range_end = first + n_pages * counter_size;
+        });
     }
+    advise_range();
 }
 
 /*
- * Time-triggered simulation mode.
+ * Runs fn() on the given chunk of a node memory, reading ahead and writing
+ * behind around it if the memory is out of core.
  */
-#if 0
-void
-Endurer::do_sim_time()
+inline void
+Endurer::run_node_chunk(uint32_t node, uint64_t chunk,
+        const std::function<void()>& fn)
 {
-    double remap_timer = 0;
+    if (memory_fds.empty()) {
+        fn();
+        return;
+    }
 
-    // outer loop: apply write set to memory at shifted offset
-    while (true) {
+    uint64_t window_chunk = chunk % COUNTER_WINDOW_N_CHUNKS;
+    if (window_chunk == 0)
+        advise_counter_window(node, chunk + COUNTER_WINDOW_N_CHUNKS, false);
+    fn();
+    if (window_chunk == COUNTER_WINDOW_N_CHUNKS - 1 or
+            chunk == n_chunks_per_node - 1)
+        advise_counter_window(node, chunk - window_chunk, true);
+}
 
-        bool should_terminate = false;
-        // inner loop: apply page writes to individual pages
-        for (size_t i = 0; i < write_set_n_pages; ++i) {
-            uint64_t new_writes = write_set[i];
+/*
+ * Returns the index of the block of owner_block_n_chunks chunks that holds
+ * the given one, counting across node memories.
+ */
+inline uint64_t
+Endurer::get_owner_block(uint32_t node, uint64_t chunk)
+{
+    uint64_t n_blocks_per_node = (n_chunks_per_node + owner_block_n_chunks -
+            1) / owner_block_n_chunks;
+    return node * n_blocks_per_node + chunk / owner_block_n_chunks;
+}
 
-            size_t mem_idx = (i + curr_offset) % memory_n_pages;
+/*
+ * Runs fn(node, chunk) in parallel over every chunk of the first n_nodes node
+ * memories, each on the thread that owns it (see find_write_set_chunks()).
+ */
+void
+Endurer::parallel_for_node_chunks(uint32_t n_nodes,
+        const std::function<void(uint32_t, uint64_t)>& fn)
+{
+    auto run_block = [&](uint64_t block) {
+        uint64_t n_blocks_per_node = get_owner_block(1, 0);
+        uint32_t node = block / n_blocks_per_node;
+        uint64_t first_chunk = block % n_blocks_per_node *
+                owner_block_n_chunks;
+        uint64_t end_chunk = MIN(first_chunk + owner_block_n_chunks,
+                n_chunks_per_node);
+        for (uint64_t chunk = first_chunk; chunk < end_chunk; ++chunk)
+            run_node_chunk(node, chunk, [&]() { fn(node, chunk); });
+    };
+
+    uint64_t n_blocks = get_owner_block(n_nodes, 0);
+    if (thread_pool == nullptr) {
+        for (uint64_t block = 0; block < n_blocks; ++block) run_block(block);
+        return;
+    }
 
-            // don't need to track period writes
-            memory[mem_idx].total_writes += new_writes;
+    // (with as many tasks as threads, task i runs on thread i)
+    uint32_t n_threads = thread_pool->get_n_threads();
+    thread_pool->parallel_for(n_threads, [&](size_t thread) {
+        for (uint64_t block = thread; block < n_blocks; block += n_threads)
+            run_block(block);
+    });
+}
 
-            if (memory[mem_idx].total_writes >= cell_write_endurance) {
-                should_terminate = true;
-            }
+/*
+ * Lists the chunks of each node memory that its write set currently lands on
+ * (see for_each_write_set_range()), in order, node by node: a pass only
+ * touches those, however large the memory. A node's chunks are
+ * [write_set_chunks_first[node], write_set_chunks_first[node + 1]). A node
+ * memory made of a range tree is a single chunk.
+ * Whichever chunks a pass touches, each is always worked on by the same
+ * thread, its owner: blocks of owner_block_n_chunks chunks (counting across
+ * node memories) are dealt out to threads round-robin. A chunk's counters are
+ * thus first touched, and so placed, on its owner's NUMA node, and stay local
+ * to it for the rest of the run (see create_node_counters()).
+ */
+void
+Endurer::find_write_set_chunks()
+{
+    write_set_chunks.clear();
+    write_set_chunks_first.resize(n_nodes + 1);
+
+    for (uint32_t node = 0; node < n_nodes; ++node) {
+        write_set_chunks_first[node] = write_set_chunks.size();
+        if (write_sets_are_runs) {
+            write_set_chunks.push_back({ node, 0, get_owner_block(node, 0) });
+            continue;
         }
 
-        if (should_terminate) break;
+        uint64_t intra_node_offset = intra_node_offsets[node];
+        uint64_t write_set_n_pages =
+                write_sets_n_pages[get_write_set_idx(node)];
+        uint64_t n_head_pages = MIN(write_set_n_pages,
+                memory_n_pages - intra_node_offset);
+        uint64_t n_tail_pages = write_set_n_pages - n_head_pages;
+
+        // tail: memory pages [0, n_tail); head: [offset, offset + n_head),
+        // sharing a chunk if the two meet in one
+        uint64_t tail_end_chunk = (n_tail_pages + CHUNK_N_PAGES - 1) /
+                CHUNK_N_PAGES;
+        uint64_t head_first_chunk = MAX(intra_node_offset / CHUNK_N_PAGES,
+                tail_end_chunk);
+        uint64_t head_end_chunk = (intra_node_offset + n_head_pages +
+                CHUNK_N_PAGES - 1) / CHUNK_N_PAGES;
+
+        for (uint64_t chunk = 0; chunk < tail_end_chunk; ++chunk) {
+            write_set_chunks.push_back({ node, chunk,
+                    get_owner_block(node, chunk) });
+        }
+        for (uint64_t chunk = head_first_chunk; chunk < head_end_chunk;
+                ++chunk) {
+            write_set_chunks.push_back({ node, chunk,
+                    get_owner_block(node, chunk) });
+        }
+    }
+    write_set_chunks_first[n_nodes] = write_set_chunks.size();
 
-        ++n_iterations;
+    chunk_results.resize(write_set_chunks.size());
+}
 
-        remap_timer += input_time_units;
+/*
+ * Runs fn(node, chunk, result_idx) in parallel over every chunk of the first
+ * n_nodes node memories that their write sets land on, each on the thread
+ * that owns it (see find_write_set_chunks()). result_idx is the chunk's index
+ * into chunk_results.
+ */
+void
+Endurer::parallel_for_write_set_chunks(uint32_t n_nodes,
+        const std::function<void(uint32_t, uint64_t, size_t)>& fn)
+{
+    find_write_set_chunks();
+
+    auto task = [&](size_t task) {
+        uint32_t node = write_set_chunks[task].node;
+        uint64_t chunk = write_set_chunks[task].chunk;
+        run_node_chunk(node, chunk, [&]() { fn(node, chunk, task); });
+    };
+
+    size_t n_tasks = write_set_chunks_first[n_nodes];
+    if (thread_pool == nullptr) {
+        for (size_t i = 0; i < n_tasks; ++i) task(i);
+        return;
+    }
 
-        if (remap_timer >= remap_period) {
-            do_remap();
-            remap_timer = 0;
+    // (with as many tasks as threads, task i runs on thread i)
+    uint32_t n_threads = thread_pool->get_n_threads();
+    thread_pool->parallel_for(n_threads, [&](size_t thread) {
+        for (size_t i = 0; i < n_tasks; ++i) {
+            if (write_set_chunks[i].owner_block % n_threads == thread)
+                task(i);
         }
-    }
+    });
 }
 
 /*
- * Simple lifetime estimate with no remapping.
+ * Returns the [begin, end) range of the node's write-set chunk results (see
+ * parallel_for_write_set_chunks()).
  */
-void
-Endurer::do_sim_lifetime()
+std::pair<std::vector<uint64_t>::iterator, std::vector<uint64_t>::iterator>
+Endurer::get_node_chunk_results(uint32_t node)
 {
-    uint64_t max_n_writes = 0;
-    uint64_t total_n_writes = 0;
+    return { chunk_results.begin() + write_set_chunks_first[node],
+            chunk_results.begin() + write_set_chunks_first[node + 1] };
+}
 
-    for (size_t i = 0; i < write_set_n_pages; ++i) {
-        if (write_set[i] > max_n_writes) max_n_writes = write_set[i];
-        total_n_writes += write_set[i];
-    }
-    printf("most-written word in histogram had this many writes: %zu\n",
-            max_n_writes);
-    printf("total number of writes in histogram (sum): %zu\n", total_n_writes);
+/*
+ * Returns the node's currently-mapped write set's nonzero pages in
+ * [page, page + n_pages), as a [begin, end) pair of pointers into its sparse
+ * form.
+ */
+std::pair<const sparse_page_t*, const sparse_page_t*>
+Endurer::get_sparse_write_set_range(uint32_t node, uint64_t page,
+        uint64_t n_pages)
+{
+    uint32_t write_set_idx = get_write_set_idx(node);
+    const sparse_page_t* sparse_write_set = sparse_write_sets[write_set_idx];
+    const sparse_page_t* sparse_write_set_end = sparse_write_set +
+            sparse_write_sets_n_pages[write_set_idx];
+    auto page_less = [](const sparse_page_t& sp, uint64_t page) {
+        return sp.page < page;
+    };
+
+    auto begin = std::lower_bound(sparse_write_set, sparse_write_set_end,
+            page, page_less);
+    auto end = std::lower_bound(begin, sparse_write_set_end, page + n_pages,
+            page_less);
+
+    return { begin, end };
+}
+
+/*
+ * Applies n_iters iterations' worth of the node's currently-mapped write set
+ * to one chunk of its memory. Returns the largest resulting total_writes
+ * under the write set within the chunk; for sparse write sets, only pages
+ * actually written are considered.
+ */
+uint64_t
+Endurer::apply_write_set(uint32_t node, uint64_t chunk, uint64_t n_iters)
+{
+    if (write_sets_are_runs) return apply_write_set_runs(node, n_iters);
+
+    auto& memory = memories[node];
+    uint32_t write_set_idx = get_write_set_idx(node);
+    auto& write_set = write_sets[write_set_idx];
+    bool write_set_is_sparse = write_sets_are_sparse[write_set_idx];
+
+    uint64_t max_writes = 0;
+    for_each_write_set_range(node, chunk, [&](uint64_t mem_idx, uint64_t page,
+            uint64_t n_pages) {
+        uint64_t range_max_writes;
+        if (write_set_is_sparse) {
+            auto range = get_sparse_write_set_range(node, page, n_pages);
+            range_max_writes = apply_sparse_page_writes(
+                    memory.total_writes, mem_idx, range.first,
+                    range.second - range.first, page, n_iters);
+        }
+        else {
+            range_max_writes = apply_page_writes(
+                    memory.total_writes, mem_idx, write_set + page, n_pages,
+                    n_iters);
+        }
+        max_writes = MAX(max_writes, range_max_writes);
+    });
 
-    double multiple_of_input_time = (double) cell_write_endurance /
-            (double) max_n_writes;
+    return max_writes;
+}
+
+/*
+ * Applies n_iters iterations' worth of pages [first_page, first_page + n_pages)
+ * of the node's currently-mapped write set to its memory, wherever they land
+ * (see for_each_write_set_range()). Returns the largest resulting total_writes
+ * under them, as apply_write_set() does.
+ */
+uint64_t
+Endurer::apply_write_set_pages(uint32_t node, uint64_t first_page,
+        uint64_t n_pages, uint64_t n_iters)
+{
+    auto& memory = memories[node];
+    uint32_t write_set_idx = get_write_set_idx(node);
+    auto& write_set = write_sets[write_set_idx];
+    bool write_set_is_sparse = write_sets_are_sparse[write_set_idx];
+
+    // split where the write set wraps around the end of memory (the page and
+    // offset are both below the memory size, so no division is needed)
+    uint64_t first_mem_idx = first_page + intra_node_offsets[node];
+    if (first_mem_idx >= memory_n_pages) first_mem_idx -= memory_n_pages;
+    uint64_t n_head_pages = MIN(n_pages, memory_n_pages - first_mem_idx);
+
+    uint64_t max_writes = 0;
+    auto apply_range = [&](uint64_t mem_idx, uint64_t page,
+            uint64_t n_pages) {
+        uint64_t range_max_writes;
+        if (write_set_is_sparse) {
+            auto range = get_sparse_write_set_range(node, page, n_pages);
+            range_max_writes = apply_sparse_page_writes(
+                    memory.total_writes, mem_idx, range.first,
+                    range.second - range.first, page, n_iters);
+        }
+        else {
+            range_max_writes = apply_page_writes(
+                    memory.total_writes, mem_idx, write_set + page, n_pages,
+                    n_iters);
+        }
+        max_writes = MAX(max_writes, range_max_writes);
+    };
 
-    time_unscaled = multiple_of_input_time * input_time_units;
+    apply_range(first_mem_idx, first_page, n_head_pages);
+    if (n_head_pages < n_pages) {
+        apply_range(0, first_page + n_head_pages, n_pages - n_head_pages);
+    }
+
+    return max_writes;
+}
+
+/*
+ * Exactly undoes a previous apply_write_set(node, chunk, n_iters).
+ */
+void
+Endurer::unapply_write_set(uint32_t node, uint64_t chunk, uint64_t n_iters)
+{
+    if (write_sets_are_runs) {
+        unapply_write_set_runs(node, n_iters);
+        return;
+    }
+
+    auto& memory = memories[node];
+    uint32_t write_set_idx = get_write_set_idx(node);
+    auto& write_set = write_sets[write_set_idx];
+    bool write_set_is_sparse = write_sets_are_sparse[write_set_idx];
+
+    for_each_write_set_range(node, chunk, [&](uint64_t mem_idx, uint64_t page,
+            uint64_t n_pages) {
+        if (write_set_is_sparse) {
+            auto range = get_sparse_write_set_range(node, page, n_pages);
+            unapply_sparse_page_writes(memory.total_writes, mem_idx,
+                    range.first, range.second - range.first, page, n_iters);
+        }
+        else {
+            unapply_page_writes(memory.total_writes, mem_idx,
+                    write_set + page, n_pages, n_iters);
+        }
+    });
+}
+
+/*
+ * Returns the number of whole iterations (under the current mapping) after
+ * which the node's write set drives some page in the chunk to the cell write
+ * endurance, or UINT64_MAX if it never does.
+ */
+uint64_t
+Endurer::get_iterations_until_wearout(uint32_t node, uint64_t chunk)
+{
+    if (write_sets_are_runs) return get_iterations_until_wearout_runs(node);
+
+    auto& memory = memories[node];
+    auto& write_set = write_sets[get_write_set_idx(node)];
+    uint64_t wearout_threshold = get_wearout_threshold(node);
+
+    uint64_t n_iters = UINT64_MAX;
+    for_each_write_set_range(node, chunk, [&](uint64_t mem_idx, uint64_t page,
+            uint64_t n_pages) {
+        uint64_t range_n_iters = get_iterations_until_threshold(
+                memory.total_writes, mem_idx, write_set + page, n_pages,
+                wearout_threshold);
+        n_iters = MIN(n_iters, range_n_iters);
+    });
+
+    return n_iters;
+}
+
+/*
+ * Returns the largest total_writes under the node's currently-mapped write
+ * set within the chunk, zero entries included (unlike apply_write_set() for
+ * sparse write sets).
+ */
+uint64_t
+Endurer::get_write_set_max(uint32_t node, uint64_t chunk)
+{
+    auto& memory = memories[node];
+
+    uint64_t max_writes = 0;
+    for_each_write_set_range(node, chunk, [&](uint64_t mem_idx, uint64_t,
+            uint64_t n_pages) {
+        max_writes = MAX(max_writes, get_max_counter(memory.total_writes,
+                mem_idx, n_pages));
+    });
+
+    return max_writes;
+}
+
+/*
+ * Calls fn(first, end, writes) for each run of the node's currently-mapped
+ * write set, with [first, end) the memory pages it lands on (split in two
+ * where the run wraps around the end of memory).
+ */
+template <typename F>
+inline void
+Endurer::for_each_write_set_run(uint32_t node, F fn)
+{
+    uint32_t write_set_idx = get_write_set_idx(node);
+    const write_run_t* runs = write_set_runs[write_set_idx];
+    uint64_t n_runs = write_sets_n_runs[write_set_idx];
+    uint64_t write_set_n_pages = write_sets_n_pages[write_set_idx];
+    uint64_t intra_node_offset = intra_node_offsets[node];
+
+    for (uint64_t i = 0; i < n_runs; ++i) {
+        uint64_t run_end = i + 1 < n_runs ? runs[i + 1].first_page :
+                write_set_n_pages;
+        uint64_t first = runs[i].first_page + intra_node_offset;
+        uint64_t end = run_end + intra_node_offset;
+
+        if (first >= memory_n_pages) {
+            fn(first - memory_n_pages, end - memory_n_pages, runs[i].writes);
+        }
+        else if (end <= memory_n_pages) fn(first, end, runs[i].writes);
+        else {
+            fn(first, memory_n_pages, runs[i].writes);
+            fn(0, end - memory_n_pages, runs[i].writes);
+        }
+    }
+}
+
+/*
+ * Returns the largest total_writes under the node's currently-mapped write
+ * set (zero entries included, as for dense write sets).
+ */
+uint64_t
+Endurer::get_write_set_runs_max(uint32_t node)
+{
+    auto& tree = *memory_trees[node];
+    uint64_t intra_node_offset = intra_node_offsets[node];
+    uint64_t write_set_n_pages = write_sets_n_pages[get_write_set_idx(node)];
+
+    uint64_t n_head_pages = MIN(write_set_n_pages,
+            memory_n_pages - intra_node_offset);
+    uint64_t head_max = tree.get_max(intra_node_offset,
+            intra_node_offset + n_head_pages);
+    uint64_t tail_max = tree.get_max(0, write_set_n_pages - n_head_pages);
+
+    return MAX(head_max, tail_max);
+}
+
+/*
+ * Run-at-a-time counterparts of apply_write_set(), unapply_write_set(), and
+ * get_iterations_until_wearout(), for node memories kept as range trees:
+ * every page of a run gets the same writes, and the first of them to reach
+ * the threshold is the one with the most writes so far.
+ */
+uint64_t
+Endurer::apply_write_set_runs(uint32_t node, uint64_t n_iters)
+{
+    auto& tree = *memory_trees[node];
+    for_each_write_set_run(node, [&](uint64_t first, uint64_t end,
+            uint64_t writes) {
+        if (writes != 0) tree.add(first, end, writes * n_iters);
+    });
+
+    return get_write_set_runs_max(node);
+}
+
+void
+Endurer::unapply_write_set_runs(uint32_t node, uint64_t n_iters)
+{
+    auto& tree = *memory_trees[node];
+    for_each_write_set_run(node, [&](uint64_t first, uint64_t end,
+            uint64_t writes) {
+        if (writes != 0) tree.subtract(first, end, writes * n_iters);
+    });
+}
+
+uint64_t
+Endurer::get_iterations_until_wearout_runs(uint32_t node)
+{
+    auto& tree = *memory_trees[node];
+    uint64_t wearout_threshold = get_wearout_threshold(node);
+    if (get_write_set_runs_max(node) >= wearout_threshold) return 1;
+
+    uint64_t n_iters = UINT64_MAX;
+    for_each_write_set_run(node, [&](uint64_t first, uint64_t end,
+            uint64_t writes) {
+        if (writes == 0) return;
+
+        uint64_t headroom = wearout_threshold - tree.get_max(first, end);
+        n_iters = MIN(n_iters, (headroom + writes - 1) / writes);
+    });
+
+    return n_iters;
+}
+
+/*
+ * Write- and time-triggered simulation modes.
+ * The two only differ in when a remap is triggered (see
+ * get_iterations_per_remap()). Within a remap period the mapping is fixed, so
+ * every page receives the same number of writes each iteration. Rather than
+ * stepping one iteration at a time, we fast-forward whole iterations in a
+ * single pass up to the next remap. If a pass would wear out a page, it is
+ * rolled back and the exact iteration is found in closed form; only that final
+ * iteration is resolved node-by-node. Node memory chunks are independent
+ * within a pass, so each pass runs them in parallel and reduces their
+ * per-chunk results (in node order) once all have finished. With
+ * --fft-batch, whole remap periods are batched up where possible (see
+ * do_fft_batch()).
+ */
+void
+Endurer::do_sim_remapped()
+{
+    start_sim();
+    if (resume) load_checkpoint();
+    last_checkpoint_time = std::chrono::steady_clock::now();
+
+    while (true) {
+        if (write_sets_are_runs) move_memory_trees_to_counters();
+
+        if (!do_fft_batch()) {
+            uint64_t n_iters = get_pass_iterations();
+
+            // outer loop: apply write sets to all nodes
+            parallel_for_write_set_chunks(n_nodes, [&](uint32_t node,
+                    uint64_t chunk, size_t result_idx) {
+                chunk_results[result_idx] = apply_write_set(node, chunk,
+                        n_iters);
+            });
+
+            for (uint32_t node = 0; node < n_nodes; ++node) {
+                auto node_results = get_node_chunk_results(node);
+                nodes_pass_max_writes[node] = *std::max_element(
+                        node_results.first, node_results.second);
+            }
+
+            if (finish_pass(n_iters)) break;
+        }
+
+        std::chrono::duration<double> since_checkpoint =
+                std::chrono::steady_clock::now() - last_checkpoint_time;
+        if (!checkpoint_path.empty() and
+                since_checkpoint.count() >= checkpoint_interval) {
+            save_checkpoint();
+        }
+    }
+}
+
+/*
+ * Checkpoints hold everything that evolves over a run, taken between two
+ * passes, so that a resumed run continues bit-exactly; they start with the
+ * parameters that shape a run, so that one isn't resumed under others. All
+ * values are stored raw (native byte order), as:
+ * - CHECKPOINT_MAGIC, and the size of the parameters that follow.
+ * - parameters: mode, endurance, remap period, node memory size, counter
+ *   width, the number of nodes, each write set's size and time units, the
+ *   largest write-set entry, and the replica.
+ * - state: the cluster shift; iteration, remap and period iteration counts;
+ *   each node's offset, remap epoch, runtime, and bound on its page writes;
+ *   the (text-serialized) PRNG state.
+ * - each node memory's counters.
+ */
+template <typename T>
+static void
+append_value(std::vector<char>& blob, const T& value)
+{
+    const char* bytes = (const char*) &value;
+    blob.insert(blob.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static void
+append_values(std::vector<char>& blob, const std::vector<T>& values)
+{
+    for (auto& value : values) append_value(blob, value);
+}
+
+static void
+append_string(std::vector<char>& blob, const std::string& str)
+{
+    append_value(blob, (uint64_t) str.size());
+    blob.insert(blob.end(), str.begin(), str.end());
+}
+
+void
+Endurer::append_checkpoint_params(std::vector<char>& blob)
+{
+    append_string(blob, mode);
+    append_value(blob, cell_write_endurance);
+    append_value(blob, remap_period);
+    append_value(blob, memory_n_pages);
+    append_value(blob, counter_bits);
+    append_value(blob, n_nodes);
+    append_values(blob, write_sets_n_pages);
+    append_values(blob, input_time_units);
+    append_value(blob, max_page_writes);
+    append_value(blob, replica);
+}
+
+/*
+ * Snapshots the run's state and writes it out in the background, replacing
+ * the previous checkpoint only once the new one is complete. Only the
+ * snapshot itself (a parallel copy of the counters) holds up the simulation;
+ * if the previous checkpoint is still being written, though, it is waited for.
+ */
+void
+Endurer::save_checkpoint()
+{
+    if (checkpoint_writer.joinable()) checkpoint_writer.join();
+
+    size_t counters_size = memory_n_pages * (counter_bits / 8);
+    if (checkpoint_snapshot == nullptr) {
+        checkpoint_snapshot_size = n_nodes * counters_size;
+        checkpoint_snapshot = mmap(nullptr, checkpoint_snapshot_size,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (checkpoint_snapshot == MAP_FAILED) {
+            checkpoint_snapshot = nullptr;
+            print_warning("could not allocate checkpoint snapshot; not "
+                    "checkpointing");
+            checkpoint_path.clear();
+            return;
+        }
+    }
+
+    std::vector<char> params;
+    append_checkpoint_params(params);
+
+    std::stringstream rand_state;
+    rand_state << rand_gen << " " << rand_dist;
+
+    checkpoint_header.clear();
+    checkpoint_header.insert(checkpoint_header.end(), CHECKPOINT_MAGIC,
+            CHECKPOINT_MAGIC + sizeof(CHECKPOINT_MAGIC));
+    append_value(checkpoint_header, (uint64_t) params.size());
+    checkpoint_header.insert(checkpoint_header.end(), params.begin(),
+            params.end());
+    append_value(checkpoint_header, cluster_node_shift);
+    append_value(checkpoint_header, n_iterations);
+    append_value(checkpoint_header, n_remaps);
+    append_value(checkpoint_header, period_iterations);
+    append_values(checkpoint_header, intra_node_offsets);
+    append_values(checkpoint_header, remap_epochs);
+    append_values(checkpoint_header, runtimes);
+    append_values(checkpoint_header, nodes_max_writes);
+    append_string(checkpoint_header, rand_state.str());
+
+    size_t counter_size = counter_bits / 8;
+    parallel_for_node_chunks(n_nodes, [&](uint32_t node, uint64_t chunk) {
+        uint64_t chunk_start = chunk * CHUNK_N_PAGES;
+        uint64_t chunk_n_pages = MIN(CHUNK_N_PAGES,
+                memory_n_pages - chunk_start);
+
+        memcpy((char*) checkpoint_snapshot + node * counters_size +
+                chunk_start * counter_size,
+                (char*) memories[node].total_writes.base +
+                chunk_start * counter_size, chunk_n_pages * counter_size);
+    });
+
+    checkpoint_writer = std::thread(&Endurer::write_checkpoint, this);
+    last_checkpoint_time = std::chrono::steady_clock::now();
+}
+
+/*
+ * Writes the current snapshot out (on the checkpoint writer thread). A failed
+ * checkpoint is only warned about: the run itself can carry on.
+ */
+void
+Endurer::write_checkpoint()
+{
+    std::string tmp_path = checkpoint_path + ".tmp";
+
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        print_warning("could not create checkpoint file %s", tmp_path.c_str());
+        return;
+    }
+
+    bool ok = pwrite_all(fd, checkpoint_header.data(),
+            checkpoint_header.size(), 0) and
+            pwrite_all(fd, checkpoint_snapshot, checkpoint_snapshot_size,
+            checkpoint_header.size());
+
+    ok = ok and fsync(fd) == 0;
+    ok = close(fd) == 0 and ok;
+    ok = ok and rename(tmp_path.c_str(), checkpoint_path.c_str()) == 0;
+
+    if (!ok) print_warning("could not write checkpoint %s", tmp_path.c_str());
+}
+
+/*
+ * Restores the state saved by save_checkpoint(), once start_sim() has set up
+ * a fresh run with the same parameters.
+ */
+void
+Endurer::load_checkpoint()
+{
+    FILE* file = fopen(checkpoint_path.c_str(), "rb");
+    if (file == nullptr)
+        print_message_and_die("could not open checkpoint to resume from");
+
+    auto read_all = [&](void* data, size_t size) {
+        if (fread(data, 1, size, file) != size)
+            print_message_and_die("checkpoint is truncated or unreadable");
+    };
+    auto read_string = [&]() {
+        uint64_t size;
+        read_all(&size, sizeof(size));
+        std::string str(size, '\0');
+        read_all(&str[0], size);
+        return str;
+    };
+
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    read_all(magic, sizeof(magic));
+    if (memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)
+        print_message_and_die("not a checkpoint (or an incompatible one)");
+
+    std::vector<char> expected_params;
+    append_checkpoint_params(expected_params);
+
+    uint64_t params_size;
+    read_all(&params_size, sizeof(params_size));
+    std::vector<char> params(params_size);
+    read_all(params.data(), params_size);
+    if (params != expected_params)
+        print_message_and_die("checkpoint was written by a run with other "
+                "parameters or input files");
+
+    read_all(&cluster_node_shift, sizeof(cluster_node_shift));
+    read_all(&n_iterations, sizeof(n_iterations));
+    read_all(&n_remaps, sizeof(n_remaps));
+    read_all(&period_iterations, sizeof(period_iterations));
+    read_all(intra_node_offsets.data(), n_nodes * sizeof(uint64_t));
+    read_all(remap_epochs.data(), n_nodes * sizeof(uint64_t));
+    read_all(runtimes.data(), n_nodes * sizeof(double));
+    read_all(nodes_max_writes.data(), n_nodes * sizeof(uint64_t));
+    nodes_mapped_max_writes = nodes_max_writes;
+
+    std::stringstream rand_state(read_string());
+    rand_state >> rand_gen >> rand_dist;
+
+    // the counters, read in chunk by chunk by each chunk's owner, which so
+    // first touches it
+    size_t counter_size = counter_bits / 8;
+    uint64_t counters_offset = ftell(file);
+    std::atomic<bool> counters_ok(true);
+    parallel_for_node_chunks(n_nodes, [&](uint32_t node, uint64_t chunk) {
+        uint64_t chunk_start = chunk * CHUNK_N_PAGES;
+        uint64_t chunk_n_pages = MIN(CHUNK_N_PAGES,
+                memory_n_pages - chunk_start);
+        if (!pread_all(fileno(file), (char*) memories[node].total_writes.base +
+                chunk_start * counter_size, chunk_n_pages * counter_size,
+                counters_offset + (node * memory_n_pages + chunk_start) *
+                counter_size))
+            counters_ok = false;
+    });
+    if (!counters_ok)
+        print_message_and_die("checkpoint is truncated or unreadable");
+
+    fclose(file);
+}
+
+/*
+ * Sets up the state kept across passes.
+ */
+void
+Endurer::start_sim()
+{
+    // resize(), not reserve! we need these to have default values (0) initially
+    intra_node_offsets.resize(n_nodes);
+    runtimes.resize(n_nodes);
+    remap_epochs.resize(n_nodes);
+    nodes_pass_max_writes.resize(n_nodes);
+    nodes_max_writes.resize(n_nodes);
+    nodes_mapped_max_writes.resize(n_nodes);
+
+    iterations_per_remap = get_iterations_per_remap();
+
+    // largest fast-forward that can't overflow a page counter
+    uint64_t endurance = cell_write_endurance;
+    max_iters_per_pass = max_page_writes == 0 ? 1 :
+            MAX(endurance / max_page_writes, (uint64_t) 1);
+    fft_batch_limit = fft_batch_periods;
+}
+
+/*
+ * Returns the number of whole iterations the next pass may apply: up to the
+ * next remap, but no more than a page counter can take.
+ */
+uint64_t
+Endurer::get_pass_iterations()
+{
+    return MIN(iterations_per_remap - period_iterations, max_iters_per_pass);
+}
+
+/*
+ * Completes a pass of n_iters iterations, once it has been applied to every
+ * node and the largest resulting total_writes under each node's write set is
+ * in nodes_pass_max_writes: resolves a wearout within the pass, if any, and
+ * otherwise accounts for the pass and remaps if it is due. Returns whether a
+ * page wore out (ending the simulation).
+ */
+bool
+Endurer::finish_pass(uint64_t n_iters)
+{
+    for (uint32_t node = 0; node < n_nodes; ++node) {
+        nodes_max_writes[node] = MAX(nodes_max_writes[node],
+                nodes_pass_max_writes[node]);
+        nodes_mapped_max_writes[node] = MAX(nodes_mapped_max_writes[node],
+                nodes_pass_max_writes[node]);
+    }
+
+    auto may_be_worn_out = [&]() {
+        for (uint32_t node = 0; node < n_nodes; ++node) {
+            uint64_t max_writes = nodes_pass_max_writes[node];
+
+            // sparse write sets skip their zero pages, which wear out too if
+            // they are under the write set once the threshold drops to meet
+            // them; only a bound on every page under it can rule that out
+            if (write_sets_are_sparse[get_write_set_idx(node)])
+                max_writes = nodes_mapped_max_writes[node];
+
+            if (max_writes >= get_wearout_threshold(node)) return true;
+        }
+        return false;
+    };
+
+    // the pass may cross several endurances; all but the last let the
+    // simulation carry on
+    while (may_be_worn_out()) {
+        parallel_for_write_set_chunks(n_nodes, [&](uint32_t node,
+                uint64_t chunk, size_t result_idx) {
+            unapply_write_set(node, chunk, n_iters);
+            chunk_results[result_idx] = get_iterations_until_wearout(node,
+                    chunk);
+        });
+
+        // the final iteration only runs up to (and including) the first
+        // node to wear out
+        uint64_t n_iters_until_wearout = UINT64_MAX;
+        uint32_t worn_node = 0;
+        for (uint32_t node = 0; node < n_nodes; ++node) {
+            auto node_results = get_node_chunk_results(node);
+            uint64_t node_n_iters = *std::min_element(node_results.first,
+                    node_results.second);
+            if (node_n_iters < n_iters_until_wearout) {
+                n_iters_until_wearout = node_n_iters;
+                worn_node = node;
+            }
+        }
+
+        bool is_last_endurance = n_endurances_crossed + 1 ==
+                cell_write_endurances.size();
+        if (n_iters_until_wearout <= n_iters and is_last_endurance) {
+            // apply all whole iterations preceding the final one...
+            uint64_t n_whole_iters = n_iters_until_wearout - 1;
+            if (n_whole_iters != 0) {
+                parallel_for_write_set_chunks(n_nodes, [&](uint32_t node,
+                        uint64_t chunk, size_t) {
+                    apply_write_set(node, chunk, n_whole_iters);
+                });
+                for (uint32_t node = 0; node < n_nodes; ++node) {
+                    runtimes[node] += n_whole_iters *
+                            input_time_units[get_write_set_idx(node)];
+                }
+                n_iterations += n_whole_iters;
+                period_iterations += n_whole_iters;
+            }
+
+            // ...then the final one
+            parallel_for_write_set_chunks(worn_node + 1, [&](uint32_t node,
+                    uint64_t chunk, size_t) {
+                apply_write_set(node, chunk, 1);
+            });
+            for (uint32_t node = 0; node <= worn_node; ++node)
+                runtimes[node] += input_time_units[get_write_set_idx(node)];
+
+            record_endurance_crossing(0, worn_node, false);
+            return true;
+        }
+
+        // either a false alarm from the sparse bound, or an endurance short
+        // of the last: record where the run would have ended for it, and redo
+        // the pass
+        if (n_iters_until_wearout <= n_iters) {
+            record_endurance_crossing(n_iters_until_wearout - 1, worn_node,
+                    true);
+        }
+        parallel_for_write_set_chunks(n_nodes, [&](uint32_t node,
+                uint64_t chunk, size_t) {
+            apply_write_set(node, chunk, n_iters);
+        });
+
+        if (n_iters_until_wearout <= n_iters) continue;
+
+        // a false alarm from a sparse bound, which would go off again on
+        // every later pass of the period: tighten the bounds to the pages
+        // actually under the write sets, just checked to be short of it
+        parallel_for_write_set_chunks(n_nodes, [&](uint32_t node,
+                uint64_t chunk, size_t result_idx) {
+            if (write_sets_are_sparse[get_write_set_idx(node)])
+                chunk_results[result_idx] = get_write_set_max(node, chunk);
+        });
+        for (uint32_t node = 0; node < n_nodes; ++node) {
+            if (!write_sets_are_sparse[get_write_set_idx(node)]) continue;
+
+            auto node_results = get_node_chunk_results(node);
+            nodes_mapped_max_writes[node] = *std::max_element(
+                    node_results.first, node_results.second);
+        }
+        break;
+    }
+
+    for (uint32_t node = 0; node < n_nodes; ++node)
+        runtimes[node] += n_iters * input_time_units[get_write_set_idx(node)];
+
+    period_iterations += n_iters;
+    if (period_iterations == iterations_per_remap) {
+        do_remap();
+    }
+    else if (max_page_writes == 0 && iterations_per_remap == UINT64_MAX) {
+        print_message_and_die("write sets are empty and no remap is ever "
+                "triggered; simulation would never terminate");
+    }
+
+    n_iterations += n_iters;
+    print_progress(n_iters);
+
+    return false;
+}
+
+/*
+ * Prints progress (roughly every 5 iterations, at most once per pass), once
+ * the last n_iters iterations are accounted for.
+ */
+void
+Endurer::print_progress(uint64_t n_iters)
+{
+    if (!is_sweep_point and n_iterations / 5 != (n_iterations - n_iters) / 5) {
+        double avg_runtime = std::accumulate(runtimes.begin(),
+                runtimes.end(), 0.0) / runtimes.size();
+        printf("At %zu iterations: %zu remaps; avg. runtime %f\n",
+                n_iterations, n_remaps, avg_runtime);
+    }
+}
+
+/*
+ * Fast-forwards through whole remap periods in one batch (of up to
+ * fft_batch_periods), rather than a pass per period, if the run is at the
+ * start of one. Over a batch, each write set lands on a node at the offsets
+ * drawn for the periods it spends there, so the node receives the circular
+ * convolution of the write set with those offsets' indicator, weighted by the
+ * iterations per remap (see get_fft_batch_writes()). Every page's writes are
+ * found before any is applied: if they would cross the next endurance, the
+ * batch is rolled back and its periods are stepped through exactly instead
+ * (retrying would cost another batch's transforms), with the batch halved for
+ * next time, until the endurance is crossed. Returns whether a batch was
+ * applied.
+ */
+bool
+Endurer::do_fft_batch()
+{
+    if (fft_batch_periods == 0 or period_iterations != 0 or
+            iterations_per_remap == UINT64_MAX or
+            n_remaps < fft_stepping_until_remap) {
+        return false;
+    }
+
+    if (n_endurances_crossed != fft_batch_endurance_idx) {
+        fft_batch_endurance_idx = n_endurances_crossed;
+        fft_batch_limit = fft_batch_periods;
+    }
+
+    // transforms are only exact for pages receiving fewer writes than the
+    // modulus
+    uint64_t n_periods = fft_batch_limit;
+    if (max_page_writes != 0) {
+        n_periods = MIN(n_periods, (NTT_MODULUS - 1) / max_page_writes /
+                iterations_per_remap);
+    }
+    if (n_periods < 2) return false;
+
+    if (write_set_transforms.empty() and max_page_writes != 0) {
+        // convolutions around memories of power-of-two sizes are circular
+        // ones of the same length; around others, they are linear ones long
+        // enough not to wrap, folded around the end of memory afterwards
+        uint64_t max_write_set_n_pages = *std::max_element(
+                write_sets_n_pages.begin(), write_sets_n_pages.end());
+        uint64_t linear_n_points = memory_n_pages + max_write_set_n_pages - 1;
+
+        fft_n_points = memory_n_pages;
+        if ((memory_n_pages & (memory_n_pages - 1)) != 0) {
+            fft_n_points = 1;
+            while (fft_n_points < linear_n_points) fft_n_points *= 2;
+        }
+
+        write_set_transforms.resize(n_nodes);
+        auto transform_write_set = [&](size_t i) {
+            auto& transform = write_set_transforms[i];
+            transform.assign(fft_n_points, 0);
+            std::copy(write_sets[i], write_sets[i] + write_sets_n_pages[i],
+                    transform.begin());
+            ntt_forward(transform.data(), fft_n_points);
+        };
+        if (thread_pool == nullptr) {
+            for (size_t i = 0; i < n_nodes; ++i) transform_write_set(i);
+        }
+        else thread_pool->parallel_for(n_nodes, transform_write_set);
+    }
+
+    // draw the batch's remaps up front (keeping what's needed to roll them
+    // back), accounting for each period's passes just as finish_pass() would
+    auto saved_rand_gen = rand_gen;
+    auto saved_intra_node_offsets = intra_node_offsets;
+    auto saved_remap_epochs = remap_epochs;
+    auto saved_runtimes = runtimes;
+    uint32_t saved_cluster_node_shift = cluster_node_shift;
+    uint64_t saved_n_iterations = n_iterations;
+    uint64_t saved_n_remaps = n_remaps;
+
+    std::vector<uint32_t> period_shifts(n_periods);
+    std::vector<uint64_t> period_offsets(n_periods * n_nodes);
+    std::vector<uint64_t> wearout_thresholds(n_nodes);
+    for (uint64_t period = 0; period < n_periods; ++period) {
+        period_shifts[period] = cluster_node_shift;
+        std::copy(intra_node_offsets.begin(), intra_node_offsets.end(),
+                period_offsets.begin() + period * n_nodes);
+
+        uint64_t n_iters_left = iterations_per_remap;
+        while (n_iters_left != 0) {
+            uint64_t n_iters = MIN(n_iters_left, max_iters_per_pass);
+            for (uint32_t node = 0; node < n_nodes; ++node) {
+                runtimes[node] += n_iters *
+                        input_time_units[get_write_set_idx(node)];
+            }
+            n_iterations += n_iters;
+            n_iters_left -= n_iters;
+        }
+
+        // a page wearing out in any period also has by the last one
+        if (period + 1 == n_periods) {
+            for (uint32_t node = 0; node < n_nodes; ++node)
+                wearout_thresholds[node] = get_wearout_threshold(node);
+        }
+        do_remap();
+    }
+
+    batch_writes.resize(n_nodes);
+    std::vector<uint8_t> nodes_wear_out(n_nodes);
+    auto get_node_batch_writes = [&](size_t node) {
+        batch_writes[node].resize(MAX(fft_n_points, memory_n_pages));
+        get_fft_batch_writes(node, n_periods, period_shifts, period_offsets,
+                batch_writes[node].data());
+        nodes_wear_out[node] = get_iterations_until_threshold(
+                memories[node].total_writes, 0, batch_writes[node].data(),
+                memory_n_pages, wearout_thresholds[node]) == 1;
+    };
+    if (thread_pool == nullptr) {
+        for (size_t node = 0; node < n_nodes; ++node)
+            get_node_batch_writes(node);
+    }
+    else thread_pool->parallel_for(n_nodes, get_node_batch_writes);
+
+    if (std::find(nodes_wear_out.begin(), nodes_wear_out.end(), 1) !=
+            nodes_wear_out.end()) {
+        rand_gen = saved_rand_gen;
+        intra_node_offsets = saved_intra_node_offsets;
+        remap_epochs = saved_remap_epochs;
+        runtimes = saved_runtimes;
+        cluster_node_shift = saved_cluster_node_shift;
+        n_iterations = saved_n_iterations;
+        n_remaps = saved_n_remaps;
+
+        fft_stepping_until_remap = n_remaps + n_periods;
+        fft_batch_limit /= 2;
+        return false;
+    }
+
+    // (a batch lands on the whole of each node memory)
+    std::vector<uint64_t> batch_chunk_results(n_nodes * n_chunks_per_node);
+    parallel_for_node_chunks(n_nodes, [&](uint32_t node, uint64_t chunk) {
+        uint64_t chunk_start = chunk * CHUNK_N_PAGES;
+        uint64_t chunk_n_pages = MIN(CHUNK_N_PAGES,
+                memory_n_pages - chunk_start);
+
+        batch_chunk_results[node * n_chunks_per_node + chunk] =
+                apply_page_writes(memories[node].total_writes, chunk_start,
+                batch_writes[node].data() + chunk_start, chunk_n_pages, 1);
+    });
+    for (uint32_t node = 0; node < n_nodes; ++node) {
+        auto node_results = batch_chunk_results.begin() +
+                node * n_chunks_per_node;
+        uint64_t batch_max_writes = *std::max_element(node_results,
+                node_results + n_chunks_per_node);
+        nodes_max_writes[node] = MAX(nodes_max_writes[node],
+                batch_max_writes);
+    }
+    nodes_mapped_max_writes = nodes_max_writes;
+
+    print_progress(n_iterations - saved_n_iterations);
+
+    return true;
+}
+
+/*
+ * Sets writes[page] to the writes the node's memory page receives over a
+ * batch of n_periods remap periods, given each period's cluster shift and
+ * (per-node) offsets; the rest of writes is scratch space. Write sets landing
+ * on the node in few periods are added at each of their offsets directly; the
+ * rest are convolved with their offsets' indicator, summing the products of
+ * all of their transforms so that a single inverse transform is needed.
+ */
+void
+Endurer::get_fft_batch_writes(uint32_t node, uint64_t n_periods,
+        const std::vector<uint32_t>& period_shifts,
+        const std::vector<uint64_t>& period_offsets, uint64_t* writes)
+{
+    std::vector<std::vector<uint64_t>> write_sets_offsets(n_nodes);
+    for (uint64_t period = 0; period < n_periods; ++period) {
+        uint32_t write_set_idx = (node + period_shifts[period]) % n_nodes;
+        write_sets_offsets[write_set_idx].push_back(
+                period_offsets[period * n_nodes + node]);
+    }
+
+    // a transform costs roughly as much as adding a write set at
+    // log2(fft_n_points) offsets
+    uint64_t fft_n_points_log2 = __builtin_ctzl(fft_n_points);
+    auto is_convolved = [&](uint32_t write_set_idx) {
+        return write_sets_offsets[write_set_idx].size() *
+                write_sets_n_pages[write_set_idx] >
+                fft_n_points * fft_n_points_log2;
+    };
+
+    // (writes has room for MAX(fft_n_points, memory_n_pages) values)
+    std::fill(writes, writes + MAX(fft_n_points, memory_n_pages), 0);
+
+    std::vector<uint64_t> indicator;
+    bool any_convolved = false;
+    for (uint32_t i = 0; i < n_nodes; ++i) {
+        if (max_page_writes == 0 or !is_convolved(i)) continue;
+
+        indicator.assign(fft_n_points, 0);
+        for (uint64_t offset : write_sets_offsets[i])
+            indicator[offset] += iterations_per_remap;
+        ntt_forward(indicator.data(), fft_n_points);
+        ntt_multiply_add(writes, indicator.data(),
+                write_set_transforms[i].data(), fft_n_points);
+        any_convolved = true;
+    }
+    if (any_convolved) {
+        ntt_inverse(writes, fft_n_points);
+
+        // fold linear convolutions (which end before twice the memory size)
+        // around the end of memory
+        for (uint64_t page = memory_n_pages;
+                page < MIN(fft_n_points, 2 * memory_n_pages); ++page) {
+            writes[page - memory_n_pages] += writes[page];
+        }
+    }
+
+    for (uint32_t i = 0; i < n_nodes; ++i) {
+        if (max_page_writes != 0 and is_convolved(i)) continue;
+
+        const uint64_t* write_set = write_sets[i];
+        uint64_t write_set_n_pages = write_sets_n_pages[i];
+        for (uint64_t offset : write_sets_offsets[i]) {
+            uint64_t n_head_pages = MIN(write_set_n_pages,
+                    memory_n_pages - offset);
+            for (uint64_t page = 0; page < n_head_pages; ++page) {
+                writes[offset + page] += iterations_per_remap *
+                        write_set[page];
+            }
+            for (uint64_t page = n_head_pages; page < write_set_n_pages;
+                    ++page) {
+                writes[page - n_head_pages] += iterations_per_remap *
+                        write_set[page];
+            }
+        }
+    }
+}
+
+/*
+ * Records the stats the simulation would end with if it stopped at the next
+ * endurance, n_whole_iters whole iterations from now plus a final one on nodes
+ * up to worn_node (which, if the final iteration hasn't been applied yet, is
+ * counted here), and moves on to the next endurance.
+ */
+void
+Endurer::record_endurance_crossing(uint64_t n_whole_iters, uint32_t worn_node,
+        bool count_final_iter)
+{
+    double time_unscaled = std::numeric_limits<double>::max();
+    for (uint32_t node = 0; node < n_nodes; ++node) {
+        double input_time = input_time_units[get_write_set_idx(node)];
+        double runtime = runtimes[node] + n_whole_iters * input_time;
+        if (count_final_iter and node <= worn_node) runtime += input_time;
+
+        time_unscaled = MIN(time_unscaled, runtime);
+    }
+
+    endurance_crossings.push_back({ n_remaps, n_iterations + n_whole_iters,
+            time_unscaled });
+    ++n_endurances_crossed;
+}
+
+/*
+ * Simulates several runs ("lanes") together, in lockstep: each pass applies
+ * the same number of iterations to every lane still running, tile by tile of
+ * each write set, so that a tile read in once is applied to every lane's
+ * memories while it is still in cache. Lanes differ only in their parameters
+ * and random streams, so each finishes (and drops out) in its own pass; a
+ * lane's pass stops short at the earliest remap due in any lane, which costs
+ * nothing when, as for replicas, they all remap together. Tiles of a write
+ * set land on different parts of each lane's memories from pass to pass, so
+ * unlike single runs' chunks (see find_write_set_chunks()), these have no
+ * owning thread.
+ */
+void
+Endurer::do_sim_lanes(const std::vector<Endurer*>& lanes)
+{
+    // a tile per (write set, CHUNK_N_PAGES of its pages)
+    std::vector<uint32_t> tile_write_sets;
+    std::vector<uint64_t> tile_first_pages;
+    for (uint32_t i = 0; i < n_nodes; ++i) {
+        for (uint64_t page = 0; page < write_sets_n_pages[i];
+                page += CHUNK_N_PAGES) {
+            tile_write_sets.push_back(i);
+            tile_first_pages.push_back(page);
+        }
+    }
+    size_t n_tiles = tile_write_sets.size();
+
+    std::vector<Endurer*> running(lanes);
+    std::vector<uint64_t> tile_results(running.size() * n_tiles);
+    for (auto lane : running) lane->start_sim();
+
+    while (!running.empty()) {
+        uint64_t n_iters = UINT64_MAX;
+        for (auto lane : running) {
+            uint64_t lane_n_iters = lane->get_pass_iterations();
+            n_iters = MIN(n_iters, lane_n_iters);
+        }
+
+        thread_pool->parallel_for(n_tiles, [&](size_t tile) {
+            uint32_t write_set_idx = tile_write_sets[tile];
+            uint64_t first_page = tile_first_pages[tile];
+            uint64_t n_pages = MIN(CHUNK_N_PAGES,
+                    write_sets_n_pages[write_set_idx] - first_page);
+
+            for (size_t i = 0; i < running.size(); ++i) {
+                auto lane = running[i];
+                tile_results[i * n_tiles + tile] = lane->apply_write_set_pages(
+                        lane->get_node_idx(write_set_idx), first_page,
+                        n_pages, n_iters);
+            }
+        });
+
+        size_t n_running = 0;
+        for (size_t i = 0; i < running.size(); ++i) {
+            auto lane = running[i];
+
+            std::fill(lane->nodes_pass_max_writes.begin(),
+                    lane->nodes_pass_max_writes.end(), 0);
+            for (size_t tile = 0; tile < n_tiles; ++tile) {
+                auto& node_max_writes = lane->nodes_pass_max_writes[
+                        lane->get_node_idx(tile_write_sets[tile])];
+                uint64_t max_writes = tile_results[i * n_tiles + tile];
+                node_max_writes = MAX(node_max_writes, max_writes);
+            }
+
+            if (!lane->finish_pass(n_iters)) {
+                std::copy(tile_results.begin() + i * n_tiles,
+                        tile_results.begin() + (i + 1) * n_tiles,
+                        tile_results.begin() + n_running * n_tiles);
+                running[n_running++] = lane;
+            }
+        }
+        running.resize(n_running);
+    }
+}
+
+/*
+ * Returns the two-sided 95% critical value of Student's t distribution with
+ * the given (nonzero) degrees of freedom: tabulated for few, and from its
+ * Cornish-Fisher expansion about the normal for many.
+ */
+static double
+get_t_critical_95(uint64_t dof)
+{
+    static const double table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447,
+            2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+            2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+            2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    if (dof <= sizeof(table) / sizeof(table[0])) return table[dof - 1];
+
+    double z = 1.959964;
+    double n = dof;
+    return z + (z * z * z + z) / (4 * n) +
+            (5 * std::pow(z, 5) + 16 * z * z * z + 3 * z) / (96 * n * n);
+}
+
+/*
+ * Sets the mean, sample standard deviation, and 95% confidence interval of
+ * the mean of the given samples (the latter two are 0-wide for one sample).
+ */
+static void
+get_sample_stats(const std::vector<double>& samples, double* mean,
+        double* stddev, double* ci95_lo, double* ci95_hi)
+{
+    size_t n = samples.size();
+    *mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+
+    double sum_sq_dev = 0;
+    for (double x : samples) sum_sq_dev += (x - *mean) * (x - *mean);
+    *stddev = n > 1 ? std::sqrt(sum_sq_dev / (n - 1)) : 0;
+
+    double half_width = n > 1 ?
+            get_t_critical_95(n - 1) * *stddev / std::sqrt((double) n) : 0;
+    *ci95_lo = *mean - half_width;
+    *ci95_hi = *mean + half_width;
+}
+
+/*
+ * Reports every (endurance, remap period) combination of the swept values.
+ * Neither the endurance nor the page size changes how a simulation evolves,
+ * only when it stops and how its stats scale, so a single run per remap
+ * period covers them all, recording where it crosses each endurance on its way
+ * to the largest. With --replicas, each remap period is run once per replica,
+ * each replica remapping from its own random stream (see do_remap()), so the
+ * results don't depend on which thread ran which replica, or when. The runs
+ * share the write sets read in once, but each has its own node memories;
+ * each is simulated by a single thread, several at a time, and as their
+ * lengths vary widely, threads pick up the next one as soon as they finish
+ * their last. With fewer runs than threads, that would leave threads idle,
+ * so the runs are instead simulated one after another, each by the whole
+ * pool. With --lanes, runs are instead simulated --lanes at a time, sharing
+ * their passes over the write sets (see do_sim_lanes()).
+ */
+void
+Endurer::do_sweep()
+{
+    typedef struct {
+        uint64_t n_remaps;
+        uint64_t n_iterations;
+        double n_iterations_per_gib;
+        double time_per_gib;
+    } sweep_row_t;
+
+    size_t n_points = cell_write_endurances.size() * remap_periods.size();
+    size_t n_runs = remap_periods.size() * n_replicas;
+    std::vector<sweep_row_t> rows(page_sizes.size() * n_points * n_replicas);
+    auto get_row = [&](size_t page_size_idx, size_t point, size_t replica) {
+        return &rows[(page_size_idx * n_points + point) * n_replicas + replica];
+    };
+
+    auto get_endurance = [&](size_t point) {
+        return cell_write_endurances[point / remap_periods.size()];
+    };
+    auto get_remap_period = [&](size_t point) {
+        return remap_periods[point % remap_periods.size()];
+    };
+
+    // a run per (remap period, replica), each covering every endurance
+    auto create_run = [&](size_t run) {
+        size_t replica = run % n_replicas;
+
+        return new Endurer(*this, remap_periods[run / n_replicas],
+                n_replicas == 1 ? NO_REPLICA : (int64_t) replica);
+    };
+    auto record_run = [&](size_t run, Endurer* sweep_point) {
+        auto& endurances = sweep_point->cell_write_endurances;
+
+        for (size_t i = 0; i < page_sizes.size(); ++i) {
+            sweep_point->page_size = page_sizes[i];
+            sweep_point->stats_final = false;
+            sweep_point->compute_stats();
+            double mems_per_gib = sweep_point->mems_per_gib;
+
+            for (size_t j = 0; j < cell_write_endurances.size(); ++j) {
+                size_t point = j * remap_periods.size() + run / n_replicas;
+                size_t crossing = std::lower_bound(endurances.begin(),
+                        endurances.end(), cell_write_endurances[j]) -
+                        endurances.begin();
+                auto& stats = sweep_point->endurance_crossings[crossing];
+
+                *get_row(i, point, run % n_replicas) = { stats.n_remaps,
+                        stats.n_iterations, stats.n_iterations * mems_per_gib,
+                        stats.time_unscaled * mems_per_gib };
+            }
+        }
+    };
+
+    if (n_lanes == 1 and n_runs < thread_pool->get_n_threads()) {
+        for (size_t run = 0; run < n_runs; ++run) {
+            Endurer* sweep_point = create_run(run);
+            sweep_point->thread_pool = thread_pool;
+            sweep_point->create_node_memories();
+            sweep_point->do_sim_remapped();
+
+            record_run(run, sweep_point);
+            delete sweep_point;
+        }
+    }
+    else if (n_lanes == 1) {
+        thread_pool->parallel_for_dynamic(n_runs, [&](size_t run) {
+            Endurer* sweep_point = create_run(run);
+            sweep_point->create_node_memories();
+            sweep_point->do_sim_remapped();
+
+            record_run(run, sweep_point);
+            delete sweep_point;
+        });
+    }
+    else {
+        // consecutive runs (replicas of the same point first) share passes;
+        // the whole pool works on each batch in turn
+        for (size_t first = 0; first < n_runs; first += n_lanes) {
+            std::vector<Endurer*> lanes;
+            for (size_t run = first; run < MIN(first + n_lanes, n_runs);
+                    ++run) {
+                Endurer* lane = create_run(run);
+                lane->thread_pool = thread_pool;
+                lane->create_node_memories();
+                lanes.push_back(lane);
+            }
+
+            do_sim_lanes(lanes);
+
+            for (size_t i = 0; i < lanes.size(); ++i) {
+                record_run(first + i, lanes[i]);
+                delete lanes[i];
+            }
+        }
+    }
+
+    if (n_replicas == 1) {
+        printf("page_size,cell_write_endurance,remap_period,n_remaps,"
+                "n_iterations,n_iterations_per_gib,time_per_gib\n");
+        for (size_t i = 0; i < page_sizes.size(); ++i) {
+            for (size_t point = 0; point < n_points; ++point) {
+                auto& row = *get_row(i, point, 0);
+                printf("%zd,%zd,%g,%zu,%zu,%f,%f\n", page_sizes[i],
+                        get_endurance(point), get_remap_period(point),
+                        row.n_remaps, row.n_iterations,
+                        row.n_iterations_per_gib, row.time_per_gib);
+            }
+        }
+        return;
+    }
+
+    printf("page_size,cell_write_endurance,remap_period,n_replicas,"
+            "n_iterations_per_gib_mean,n_iterations_per_gib_stddev,"
+            "n_iterations_per_gib_ci95_lo,n_iterations_per_gib_ci95_hi,"
+            "time_per_gib_mean,time_per_gib_stddev,time_per_gib_ci95_lo,"
+            "time_per_gib_ci95_hi\n");
+    for (size_t i = 0; i < page_sizes.size(); ++i) {
+        for (size_t point = 0; point < n_points; ++point) {
+            std::vector<double> iterations_samples(n_replicas);
+            std::vector<double> time_samples(n_replicas);
+            for (size_t replica = 0; replica < n_replicas; ++replica) {
+                auto& row = *get_row(i, point, replica);
+                iterations_samples[replica] = row.n_iterations_per_gib;
+                time_samples[replica] = row.time_per_gib;
+            }
+
+            double iterations_stats[4], time_stats[4];
+            get_sample_stats(iterations_samples, &iterations_stats[0],
+                    &iterations_stats[1], &iterations_stats[2],
+                    &iterations_stats[3]);
+            get_sample_stats(time_samples, &time_stats[0], &time_stats[1],
+                    &time_stats[2], &time_stats[3]);
+
+            printf("%zd,%zd,%g,%u,%f,%f,%f,%f,%f,%f,%f,%f\n", page_sizes[i],
+                    get_endurance(point), get_remap_period(point), n_replicas,
+                    iterations_stats[0], iterations_stats[1],
+                    iterations_stats[2], iterations_stats[3], time_stats[0],
+                    time_stats[1], time_stats[2], time_stats[3]);
+        }
+    }
+}
+
+/*
+ * Simple lifetime estimate with no remapping: each node lasts until its
+ * most-written page reaches the endurance, and the cluster until its first
+ * node does. Only the largest (and, for reference, the total) entry of each
+ * write set is needed, so rather than being mapped, the input files are
+ * streamed through one fixed-size buffer per thread; each thread reduces
+ * every n_threads-th block of a file, so that together they read it roughly
+ * in order.
+ */
+void
+Endurer::do_sim_lifetime()
+{
+    write_sets_n_pages.resize(n_nodes);
+    runtimes.resize(n_nodes);
+
+    uint32_t n_readers = thread_pool->get_n_threads();
+    std::vector<std::vector<uint64_t>> buffers(n_readers,
+            std::vector<uint64_t>(LIFETIME_BLOCK_N_PAGES));
+    std::vector<uint64_t> readers_max_writes(n_readers);
+    std::vector<uint64_t> readers_sum_writes(n_readers);
+
+    for (size_t i = 0; i < n_nodes; ++i) {
+        auto& write_set_n_pages = write_sets_n_pages[i];
+        auto& info = input_files_info[i];
+        int fd = open_input_file(input_filepaths[i], &info);
+        write_set_n_pages = info.n_pages;
+        std::vector<uint64_t> checksums = read_write_set_checksums(fd, info);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        uint64_t n_blocks = (write_set_n_pages + LIFETIME_BLOCK_N_PAGES - 1) /
+                LIFETIME_BLOCK_N_PAGES;
+
+        thread_pool->parallel_for(n_readers, [&](size_t reader) {
+            auto& buffer = buffers[reader];
+            uint64_t max_writes = 0;
+            uint64_t sum_writes = 0;
+
+            for (uint64_t block = reader; block < n_blocks;
+                    block += n_readers) {
+                uint64_t first_page = block * LIFETIME_BLOCK_N_PAGES;
+                uint64_t block_n_pages = MIN(LIFETIME_BLOCK_N_PAGES,
+                        write_set_n_pages - first_page);
+
+                if (!pread_all(fd, buffer.data(), block_n_pages *
+                        sizeof(uint64_t), info.payload_offset +
+                        first_page * sizeof(uint64_t)))
+                    print_message_and_die("could not read input file");
+                // (lifetime blocks are as large as checksum blocks can be,
+                // so each holds whole ones)
+                check_write_set_block(input_filepaths[i].c_str(), info,
+                        checksums, buffer.data(), first_page, block_n_pages);
+
+                uint64_t block_max_writes, block_sum_writes;
+                reduce_page_writes(buffer.data(), block_n_pages,
+                        &block_max_writes, &block_sum_writes);
+                max_writes = MAX(max_writes, block_max_writes);
+                sum_writes += block_sum_writes;
+            }
+
+            readers_max_writes[reader] = max_writes;
+            readers_sum_writes[reader] = sum_writes;
+        });
+        close(fd);
+
+        uint64_t max_n_writes = *std::max_element(readers_max_writes.begin(),
+                readers_max_writes.end());
+        uint64_t total_n_writes = std::accumulate(readers_sum_writes.begin(),
+                readers_sum_writes.end(), (uint64_t) 0);
+        printf("WSS %zu: most-written page had this many writes: %zu\n", i,
+                max_n_writes);
+        printf("WSS %zu: total number of writes (sum): %zu\n", i,
+                total_n_writes);
+
+        double multiple_of_input_time = (double) cell_write_endurance /
+                (double) max_n_writes;
+
+        runtimes[i] = multiple_of_input_time * input_time_units[i];
+    }
 }
-#endif
 
 
 /*
@@ -373,8 +2649,8 @@ Endurer::do_sim_lifetime()
 void
 Endurer::compute_stats()
 {
-    wss_bytes.reserve(n_nodes);
-    wss_gib.reserve(n_nodes);
+    wss_bytes.resize(n_nodes);
+    wss_gib.resize(n_nodes);
 
     uint64_t gib = (1024 * 1024 * 1024);
     time_unscaled = std::numeric_limits<double>::max();
@@ -8,14 +8,22 @@
 #include <stdint.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <functional>
 #include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "kernels.h"
+#include "range_max_tree.h"
+#include "thread_pool.h"
+#include "write_set_file.h"
 
 class Endurer {
     public:
         Endurer(int argc, char* argv[]);
+        Endurer(const Endurer& sweep, double remap_period, int64_t replica);
         Endurer(const Endurer& e) = delete;
         Endurer& operator=(const Endurer& e) = delete;
         Endurer(Endurer&& e) = delete;
@@ -24,46 +32,221 @@ class Endurer {
 
         void parse_and_validate_args(int argc, char* argv[]);
         void read_input_files();
+        void size_node_memories();
         void create_node_memories();
-        void do_sim_write();
-        void do_sim_time();
+        void create_node_counters();
+        void do_sim_remapped();
+        void do_sim_lanes(const std::vector<Endurer*>& lanes);
         void do_sim_lifetime();
+        void do_sweep();
         void do_remap();
         void compute_stats();
         void print_stats();
         void run();
 
     private:
+        bool is_sweep();
+        void move_memory_trees_to_counters();
+        void start_sim();
+        uint64_t get_pass_iterations();
+        bool finish_pass(uint64_t n_iters);
+        void record_endurance_crossing(uint64_t n_whole_iters,
+                uint32_t worn_node, bool count_final_iter);
+        void append_checkpoint_params(std::vector<char>& blob);
+        void save_checkpoint();
+        void write_checkpoint();
+        void load_checkpoint();
+        void print_progress(uint64_t n_iters);
+        bool do_fft_batch();
+        void get_fft_batch_writes(uint32_t node, uint64_t n_periods,
+                const std::vector<uint32_t>& period_shifts,
+                const std::vector<uint64_t>& period_offsets, uint64_t* writes);
+        void* map_hugepage_buffer(size_t size);
         uint32_t get_write_set_idx(uint32_t node_idx);
+        uint32_t get_node_idx(uint32_t write_set_idx);
+        uint64_t get_wearout_threshold(uint32_t node);
+        uint64_t get_iterations_per_remap();
+        template <typename F>
+        void for_each_write_set_range(uint32_t node, uint64_t chunk, F fn);
+        void advise_counter_window(uint32_t node, uint64_t first_chunk,
+                bool is_write_behind);
+        uint64_t get_owner_block(uint32_t node, uint64_t chunk);
+        void run_node_chunk(uint32_t node, uint64_t chunk,
+                const std::function<void()>& fn);
+        void parallel_for_node_chunks(uint32_t n_nodes,
+                const std::function<void(uint32_t, uint64_t)>& fn);
+        void find_write_set_chunks();
+        void parallel_for_write_set_chunks(uint32_t n_nodes,
+                const std::function<void(uint32_t, uint64_t, size_t)>& fn);
+        std::pair<std::vector<uint64_t>::iterator,
+                std::vector<uint64_t>::iterator>
+                get_node_chunk_results(uint32_t node);
+        std::pair<const sparse_page_t*, const sparse_page_t*>
+                get_sparse_write_set_range(uint32_t node, uint64_t page,
+                uint64_t n_pages);
+        uint64_t apply_write_set(uint32_t node, uint64_t chunk,
+                uint64_t n_iters);
+        uint64_t apply_write_set_pages(uint32_t node, uint64_t first_page,
+                uint64_t n_pages, uint64_t n_iters);
+        void unapply_write_set(uint32_t node, uint64_t chunk,
+                uint64_t n_iters);
+        uint64_t get_iterations_until_wearout(uint32_t node, uint64_t chunk);
+        uint64_t get_write_set_max(uint32_t node, uint64_t chunk);
+        template <typename F>
+        void for_each_write_set_run(uint32_t node, F fn);
+        uint64_t get_write_set_runs_max(uint32_t node);
+        uint64_t apply_write_set_runs(uint32_t node, uint64_t n_iters);
+        void unapply_write_set_runs(uint32_t node, uint64_t n_iters);
+        uint64_t get_iterations_until_wearout_runs(uint32_t node);
 
+        // a node memory's page counters, stored structure-of-arrays: one
+        // cache-line-aligned array per counter. (per-period writes are derived
+        // from the write set, not stored.)
         typedef struct {
-            uint64_t period_writes;
-            uint64_t total_writes;
+            counter_array_t total_writes;
         } mem_t;
 
+        // a run of equal write-set entries, up to the next run's first page
+        typedef struct {
+            uint64_t first_page;
+            uint64_t writes;
+        } write_run_t;
+
         std::string mode;
         int64_t page_size;
         int64_t cell_write_endurance;
         double remap_period;
+        // the values to sweep over, if any parameter has more than one
+        std::vector<int64_t> page_sizes;
+        std::vector<int64_t> cell_write_endurances;
+        std::vector<double> remap_periods;
         std::vector<double> input_time_units;
         std::vector<std::string> input_filepaths;
+        std::vector<write_set_file_info_t> input_files_info;
+        uint32_t counter_bits;      // 0 until picked automatically
+        uint32_t n_threads;
+        uint32_t n_replicas = 1;
+        uint32_t n_lanes = 1;           // runs simulated together
+        std::string checkpoint_path;    // empty if not checkpointing
+        double checkpoint_interval = 600;   // seconds
+        bool resume = false;
+        uint32_t fft_batch_periods = 0; // 0 if not batching
+        uint64_t requested_memory_n_pages = 0;  // 0 if not given
+        double overprovision_ratio = -1;        // < 0 if not given
+        bool populate_inputs = false;
+        bool hugepage_inputs = false;
+        bool direct_inputs = false;
+        std::string memory_alloc = "thp";
+        std::string counter_dir;        // empty if node memories are in RAM
+        bool pin_threads = false;
+        int64_t replica = NO_REPLICA;   // this run's random stream
 
         static constexpr uint64_t EXTRA_WRITES_PER_REMAP = 1;
         static constexpr uint64_t RAND_SEED = 8;
+        // runs without --replicas draw from rand_gen, as before
+        static constexpr int64_t NO_REPLICA = -1;
+        static constexpr char CHECKPOINT_MAGIC[8] = { 'E', 'N', 'D', 'U', 'C',
+                'K', 'P', '2' };
+        static constexpr size_t CACHE_LINE_SIZE = 64;
+        static constexpr size_t OS_PAGE_SIZE = 4096;
+        static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+        // the unit of parallel work within a node memory: 256 KiB of counters.
+        // a whole number of OS pages (so of cache lines, too), so tasks never
+        // share either one.
+        static constexpr uint64_t CHUNK_N_PAGES = 1 << 15;
+        // node memories over this many times the largest write set aren't
+        // backed by transparent hugepages
+        static constexpr uint64_t THP_MAX_MEMORY_OVER_WRITE_SET = 4;
+        // out-of-core node memories are read ahead and written behind 16 MiB
+        // of (64-bit) counters at a time
+        static constexpr uint64_t COUNTER_WINDOW_N_CHUNKS = 64;
+        // the unit of input loading: 16 MiB of write-set entries
+        static constexpr uint64_t LOAD_BLOCK_N_PAGES = 1 << 21;
+        // the unit of lifetime-mode streaming: 16 MiB of write-set entries
+        // (the largest checksum block), read into each thread's buffer at a
+        // time
+        static constexpr uint64_t LIFETIME_BLOCK_N_PAGES =
+                WRITE_SET_MAX_CHECKSUM_BLOCK_N_PAGES;
+        // write sets with a smaller fraction of nonzero pages are applied
+        // from their sparse form
+        static constexpr double SPARSE_DENSITY_THRESHOLD = 0.25;
+        // write sets all with fewer runs per page are applied a run at a
+        // time: each run costs a few O(log n) tree operations
+        static constexpr double RUN_DENSITY_THRESHOLD = 1.0 / 256;
+
+        ThreadPool* thread_pool = nullptr;
+        bool is_sweep_point = false;
 
         uint32_t n_nodes = 0;
         uint32_t cluster_node_shift = 0;
 
-        std::vector<uint64_t*> write_sets;
+        std::vector<const uint64_t*> write_sets;     // mapped input files
         std::vector<uint64_t> write_sets_n_pages;
+        uint64_t max_page_writes = 0;   // largest entry across all write sets
+        std::vector<const sparse_page_t*> sparse_write_sets;
+        std::vector<uint64_t> sparse_write_sets_n_pages;
+        std::vector<uint8_t> write_sets_are_sparse;
+        std::vector<const write_run_t*> write_set_runs;
+        std::vector<uint64_t> write_sets_n_runs;
+        bool write_sets_are_runs = false;
 
-        std::vector<mem_t*> memories;
+        std::vector<mem_t> memories;
+        std::vector<int> memory_fds;    // their counter files, if out of core
+        std::vector<RangeMaxTree*> memory_trees;    // if applying runs
         uint64_t memory_n_pages = 0;
+        uint64_t n_chunks_per_node = 0;
+        uint64_t owner_block_n_chunks = 1;  // see find_write_set_chunks()
+        size_t memory_counters_size = 0;    // bytes, per node
 
         std::mt19937 rand_gen;
         std::uniform_int_distribution<uint64_t> rand_dist;
 
         std::vector<uint64_t> intra_node_offsets;
+        std::vector<uint64_t> remap_epochs;     // remaps not yet folded in
+        uint64_t period_iterations = 0;         // iterations since last remap
+        uint64_t iterations_per_remap = 0;
+        uint64_t max_iters_per_pass = 0;
+        // the chunks a pass touches (see find_write_set_chunks()), and their
+        // results
+        typedef struct {
+            uint32_t node;
+            uint64_t chunk;
+            uint64_t owner_block;   // see find_write_set_chunks()
+        } node_chunk_t;
+        std::vector<node_chunk_t> write_set_chunks;
+        std::vector<size_t> write_set_chunks_first;
+        std::vector<uint64_t> chunk_results;
+        std::vector<uint64_t> nodes_pass_max_writes;
+        std::vector<uint64_t> nodes_max_writes; // bound on any page's writes
+        // bound on the writes of any page under the current mapping (see
+        // finish_pass())
+        std::vector<uint64_t> nodes_mapped_max_writes;
+
+        // the stats at which each (ascending) endurance was crossed
+        typedef struct {
+            uint64_t n_remaps;
+            uint64_t n_iterations;
+            double time_unscaled;
+        } endurance_crossing_t;
+        size_t n_endurances_crossed = 0;
+        std::vector<endurance_crossing_t> endurance_crossings;
+
+        // the checkpoint being written, if any
+        std::thread checkpoint_writer;
+        std::vector<char> checkpoint_header;
+        void* checkpoint_snapshot = nullptr;    // node memories' counters
+        size_t checkpoint_snapshot_size = 0;
+        std::chrono::steady_clock::time_point last_checkpoint_time;
+
+        // FFT batches (see do_fft_batch()): each write set's transform, and
+        // each node's writes over the current batch
+        std::vector<std::vector<uint64_t>> write_set_transforms;
+        std::vector<std::vector<uint64_t>> batch_writes;
+        uint64_t fft_n_points = 0;          // the transforms' length
+        uint64_t fft_batch_limit = 0;       // halved by each rollback...
+        size_t fft_batch_endurance_idx = 0; // ...until passing this endurance
+        uint64_t fft_stepping_until_remap = 0;
+
         std::vector<double> runtimes;
         uint64_t n_iterations = 0;
         uint64_t n_remaps = 0;
@@ -0,0 +1,626 @@
+#include <immintrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <limits>
+
+#include "util.h"
+#include "kernels.h"
+
+
+typedef uint64_t (*apply_fn_t)(void*, const uint64_t*, size_t, uint64_t);
+typedef void (*unapply_fn_t)(void*, const uint64_t*, size_t, uint64_t);
+typedef void (*reduce_fn_t)(const uint64_t*, size_t, uint64_t*, uint64_t*);
+
+// one entry per counter width
+typedef struct {
+    apply_fn_t apply;
+    unapply_fn_t unapply;
+    apply_fn_t apply_narrow;
+    unapply_fn_t unapply_narrow;
+    reduce_fn_t reduce;
+} kernel_table_t;
+
+
+/*
+ * Adds to a counter, saturating if it is narrower than 64 bits.
+ */
+template <typename counter_t>
+static inline uint64_t
+add_to_counter(counter_t& counter, uint64_t new_writes)
+{
+    uint64_t sum = counter + new_writes;
+    if (sizeof(counter_t) < sizeof(uint64_t))
+        sum = MIN(sum, (uint64_t) std::numeric_limits<counter_t>::max());
+
+    counter = sum;
+    return sum;
+}
+
+template <typename counter_t>
+static uint64_t
+apply_scalar(void* counters_v, const uint64_t* page_writes, size_t n_pages,
+        uint64_t n_iters)
+{
+    counter_t* counters = (counter_t*) counters_v;
+
+    uint64_t max_counter = 0;
+    for (size_t i = 0; i < n_pages; ++i) {
+        uint64_t counter = add_to_counter(counters[i], page_writes[i] * n_iters);
+        max_counter = MAX(max_counter, counter);
+    }
+
+    return max_counter;
+}
+
+template <typename counter_t>
+static void
+unapply_scalar(void* counters_v, const uint64_t* page_writes, size_t n_pages,
+        uint64_t n_iters)
+{
+    counter_t* counters = (counter_t*) counters_v;
+
+    for (size_t i = 0; i < n_pages; ++i) counters[i] -= page_writes[i] * n_iters;
+}
+
+static void
+reduce_scalar(const uint64_t* page_writes, size_t n_pages,
+        uint64_t* max_writes, uint64_t* sum_writes)
+{
+    uint64_t max = 0;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n_pages; ++i) {
+        max = MAX(max, page_writes[i]);
+        sum += page_writes[i];
+    }
+
+    *max_writes = max;
+    *sum_writes = sum;
+}
+
+/*
+ * AVX2 has neither a 64-bit multiply nor an unsigned 64-bit compare; the
+ * former is built from 32x32->64-bit multiplies, and the latter by flipping
+ * the sign bit and using the signed compare.
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+mul_u64_avx2(__m256i a, __m256i b_lo, __m256i b_hi)
+{
+    __m256i lo = _mm256_mul_epu32(a, b_lo);
+    __m256i cross = _mm256_add_epi64(
+            _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b_lo),
+            _mm256_mul_epu32(a, b_hi));
+
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+max_u64_flipped_avx2(__m256i max_flipped, __m256i c, __m256i sign)
+{
+    __m256i c_flipped = _mm256_xor_si256(c, sign);
+    return _mm256_blendv_epi8(max_flipped, c_flipped,
+            _mm256_cmpgt_epi64(c_flipped, max_flipped));
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t
+reduce_max_u64_flipped_avx2(__m256i max_flipped, __m256i sign)
+{
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, _mm256_xor_si256(max_flipped, sign));
+
+    uint64_t max_lane = 0;
+    for (auto& lane : lanes) max_lane = MAX(max_lane, lane);
+
+    return max_lane;
+}
+
+__attribute__((target("avx2")))
+static uint64_t
+apply_avx2(void* counters_v, const uint64_t* page_writes, size_t n_pages,
+        uint64_t n_iters)
+{
+    uint64_t* counters = (uint64_t*) counters_v;
+
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i k_lo = _mm256_set1_epi64x(n_iters & 0xffffffff);
+    const __m256i k_hi = _mm256_set1_epi64x(n_iters >> 32);
+
+    // running max, kept in the sign-flipped domain
+    __m256i max_flipped = sign;
+
+    size_t i = 0;
+    for (; i + 4 <= n_pages; i += 4) {
+        __m256i w = _mm256_loadu_si256((const __m256i*) (page_writes + i));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (counters + i));
+
+        c = _mm256_add_epi64(c, n_iters == 1 ? w : mul_u64_avx2(w, k_lo, k_hi));
+        _mm256_storeu_si256((__m256i*) (counters + i), c);
+
+        max_flipped = max_u64_flipped_avx2(max_flipped, c, sign);
+    }
+
+    uint64_t max_counter = apply_scalar<uint64_t>(counters + i,
+            page_writes + i, n_pages - i, n_iters);
+
+    uint64_t max_vector = reduce_max_u64_flipped_avx2(max_flipped, sign);
+    return MAX(max_counter, max_vector);
+}
+
+__attribute__((target("avx2")))
+static void
+unapply_avx2(void* counters_v, const uint64_t* page_writes, size_t n_pages,
+        uint64_t n_iters)
+{
+    uint64_t* counters = (uint64_t*) counters_v;
+
+    const __m256i k_lo = _mm256_set1_epi64x(n_iters & 0xffffffff);
+    const __m256i k_hi = _mm256_set1_epi64x(n_iters >> 32);
+
+    size_t i = 0;
+    for (; i + 4 <= n_pages; i += 4) {
+        __m256i w = _mm256_loadu_si256((const __m256i*) (page_writes + i));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (counters + i));
+
+        c = _mm256_sub_epi64(c, mul_u64_avx2(w, k_lo, k_hi));
+        _mm256_storeu_si256((__m256i*) (counters + i), c);
+    }
+
+    unapply_scalar<uint64_t>(counters + i, page_writes + i, n_pages - i,
+            n_iters);
+}
+
+/*
+ * Streaming-only (no counters), so two independent accumulator pairs keep
+ * more loads in flight.
+ */
+__attribute__((target("avx2")))
+static void
+reduce_avx2(const uint64_t* page_writes, size_t n_pages, uint64_t* max_writes,
+        uint64_t* sum_writes)
+{
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    __m256i max_flipped_0 = sign;
+    __m256i max_flipped_1 = sign;
+    __m256i sum_0 = _mm256_setzero_si256();
+    __m256i sum_1 = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 8 <= n_pages; i += 8) {
+        __m256i w_0 = _mm256_loadu_si256((const __m256i*) (page_writes + i));
+        __m256i w_1 = _mm256_loadu_si256(
+                (const __m256i*) (page_writes + i + 4));
+
+        max_flipped_0 = max_u64_flipped_avx2(max_flipped_0, w_0, sign);
+        max_flipped_1 = max_u64_flipped_avx2(max_flipped_1, w_1, sign);
+        sum_0 = _mm256_add_epi64(sum_0, w_0);
+        sum_1 = _mm256_add_epi64(sum_1, w_1);
+    }
+
+    reduce_scalar(page_writes + i, n_pages - i, max_writes, sum_writes);
+
+    uint64_t max_0 = reduce_max_u64_flipped_avx2(max_flipped_0, sign);
+    uint64_t max_1 = reduce_max_u64_flipped_avx2(max_flipped_1, sign);
+    *max_writes = MAX(*max_writes, MAX(max_0, max_1));
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, _mm256_add_epi64(sum_0, sum_1));
+    for (auto& lane : lanes) *sum_writes += lane;
+}
+
+/*
+ * Narrow counters are widened to 64 bits in-register, saturated, and
+ * narrowed again on the way out.
+ */
+__attribute__((target("avx2")))
+static uint64_t
+apply_narrow_avx2(void* counters_v, const uint64_t* page_writes,
+        size_t n_pages, uint64_t n_iters)
+{
+    uint32_t* counters = (uint32_t*) counters_v;
+
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i k_lo = _mm256_set1_epi64x(n_iters & 0xffffffff);
+    const __m256i k_hi = _mm256_set1_epi64x(n_iters >> 32);
+    const __m256i saturated = _mm256_set1_epi64x(UINT32_MAX);
+    const __m256i saturated_flipped = _mm256_xor_si256(saturated, sign);
+    const __m256i low_dwords = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    __m256i max_flipped = sign;
+
+    size_t i = 0;
+    for (; i + 4 <= n_pages; i += 4) {
+        __m256i w = _mm256_loadu_si256((const __m256i*) (page_writes + i));
+        __m256i c = _mm256_cvtepu32_epi64(
+                _mm_loadu_si128((const __m128i*) (counters + i)));
+
+        c = _mm256_add_epi64(c, mul_u64_avx2(w, k_lo, k_hi));
+        __m256i is_over = _mm256_cmpgt_epi64(_mm256_xor_si256(c, sign),
+                saturated_flipped);
+        c = _mm256_blendv_epi8(c, saturated, is_over);
+
+        __m256i packed = _mm256_permutevar8x32_epi32(c, low_dwords);
+        _mm_storeu_si128((__m128i*) (counters + i),
+                _mm256_castsi256_si128(packed));
+
+        max_flipped = max_u64_flipped_avx2(max_flipped, c, sign);
+    }
+
+    uint64_t max_counter = apply_scalar<uint32_t>(counters + i,
+            page_writes + i, n_pages - i, n_iters);
+
+    uint64_t max_vector = reduce_max_u64_flipped_avx2(max_flipped, sign);
+    return MAX(max_counter, max_vector);
+}
+
+__attribute__((target("avx2")))
+static void
+unapply_narrow_avx2(void* counters_v, const uint64_t* page_writes,
+        size_t n_pages, uint64_t n_iters)
+{
+    uint32_t* counters = (uint32_t*) counters_v;
+
+    const __m256i k_lo = _mm256_set1_epi64x(n_iters & 0xffffffff);
+    const __m256i k_hi = _mm256_set1_epi64x(n_iters >> 32);
+    const __m256i low_dwords = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    size_t i = 0;
+    for (; i + 4 <= n_pages; i += 4) {
+        __m256i w = _mm256_loadu_si256((const __m256i*) (page_writes + i));
+        __m256i c = _mm256_cvtepu32_epi64(
+                _mm_loadu_si128((const __m128i*) (counters + i)));
+
+        c = _mm256_sub_epi64(c, mul_u64_avx2(w, k_lo, k_hi));
+
+        __m256i packed = _mm256_permutevar8x32_epi32(c, low_dwords);
+        _mm_storeu_si128((__m128i*) (counters + i),
+                _mm256_castsi256_si128(packed));
+    }
+
+    unapply_scalar<uint32_t>(counters + i, page_writes + i, n_pages - i,
+            n_iters);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static uint64_t
+apply_avx512(void* counters_v, const uint64_t* page_writes, size_t n_pages,
+        uint64_t n_iters)
+{
+    uint64_t* counters = (uint64_t*) counters_v;
+
+    const __m512i k = _mm512_set1_epi64(n_iters);
+    __m512i max_counter = _mm512_setzero_si512();
+
+    size_t i = 0;
+    for (; i + 8 <= n_pages; i += 8) {
+        __m512i w = _mm512_loadu_si512(page_writes + i);
+        __m512i c = _mm512_loadu_si512(counters + i);
+
+        c = _mm512_add_epi64(c, _mm512_mullo_epi64(w, k));
+        _mm512_storeu_si512(counters + i, c);
+        max_counter = _mm512_max_epu64(max_counter, c);
+    }
+
+    // remainder, under a mask
+    if (i < n_pages) {
+        __mmask8 m = (1 << (n_pages - i)) - 1;
+        __m512i w = _mm512_maskz_loadu_epi64(m, page_writes + i);
+        __m512i c = _mm512_maskz_loadu_epi64(m, counters + i);
+
+        c = _mm512_add_epi64(c, _mm512_mullo_epi64(w, k));
+        _mm512_mask_storeu_epi64(counters + i, m, c);
+        max_counter = _mm512_max_epu64(max_counter, c);
+    }
+
+    return _mm512_reduce_max_epu64(max_counter);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void
+unapply_avx512(void* counters_v, const uint64_t* page_writes, size_t n_pages,
+        uint64_t n_iters)
+{
+    uint64_t* counters = (uint64_t*) counters_v;
+
+    const __m512i k = _mm512_set1_epi64(n_iters);
+
+    size_t i = 0;
+    for (; i + 8 <= n_pages; i += 8) {
+        __m512i w = _mm512_loadu_si512(page_writes + i);
+        __m512i c = _mm512_loadu_si512(counters + i);
+
+        c = _mm512_sub_epi64(c, _mm512_mullo_epi64(w, k));
+        _mm512_storeu_si512(counters + i, c);
+    }
+
+    if (i < n_pages) {
+        __mmask8 m = (1 << (n_pages - i)) - 1;
+        __m512i w = _mm512_maskz_loadu_epi64(m, page_writes + i);
+        __m512i c = _mm512_maskz_loadu_epi64(m, counters + i);
+
+        c = _mm512_sub_epi64(c, _mm512_mullo_epi64(w, k));
+        _mm512_mask_storeu_epi64(counters + i, m, c);
+    }
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static uint64_t
+apply_narrow_avx512(void* counters_v, const uint64_t* page_writes,
+        size_t n_pages, uint64_t n_iters)
+{
+    uint32_t* counters = (uint32_t*) counters_v;
+
+    const __m512i k = _mm512_set1_epi64(n_iters);
+    const __m512i saturated = _mm512_set1_epi64(UINT32_MAX);
+    __m512i max_counter = _mm512_setzero_si512();
+
+    size_t i = 0;
+    for (; i + 8 <= n_pages; i += 8) {
+        __m512i w = _mm512_loadu_si512(page_writes + i);
+        __m512i c = _mm512_cvtepu32_epi64(
+                _mm256_loadu_si256((const __m256i*) (counters + i)));
+
+        c = _mm512_add_epi64(c, _mm512_mullo_epi64(w, k));
+        c = _mm512_min_epu64(c, saturated);
+        _mm256_storeu_si256((__m256i*) (counters + i),
+                _mm512_cvtepi64_epi32(c));
+        max_counter = _mm512_max_epu64(max_counter, c);
+    }
+
+    uint64_t max_tail = apply_scalar<uint32_t>(counters + i, page_writes + i,
+            n_pages - i, n_iters);
+
+    uint64_t max_vector = _mm512_reduce_max_epu64(max_counter);
+    return MAX(max_tail, max_vector);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void
+unapply_narrow_avx512(void* counters_v, const uint64_t* page_writes,
+        size_t n_pages, uint64_t n_iters)
+{
+    uint32_t* counters = (uint32_t*) counters_v;
+
+    const __m512i k = _mm512_set1_epi64(n_iters);
+
+    size_t i = 0;
+    for (; i + 8 <= n_pages; i += 8) {
+        __m512i w = _mm512_loadu_si512(page_writes + i);
+        __m512i c = _mm512_cvtepu32_epi64(
+                _mm256_loadu_si256((const __m256i*) (counters + i)));
+
+        c = _mm512_sub_epi64(c, _mm512_mullo_epi64(w, k));
+        _mm256_storeu_si256((__m256i*) (counters + i),
+                _mm512_cvtepi64_epi32(c));
+    }
+
+    unapply_scalar<uint32_t>(counters + i, page_writes + i, n_pages - i,
+            n_iters);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void
+reduce_avx512(const uint64_t* page_writes, size_t n_pages,
+        uint64_t* max_writes, uint64_t* sum_writes)
+{
+    __m512i max_0 = _mm512_setzero_si512();
+    __m512i max_1 = _mm512_setzero_si512();
+    __m512i sum_0 = _mm512_setzero_si512();
+    __m512i sum_1 = _mm512_setzero_si512();
+
+    size_t i = 0;
+    for (; i + 16 <= n_pages; i += 16) {
+        __m512i w_0 = _mm512_loadu_si512(page_writes + i);
+        __m512i w_1 = _mm512_loadu_si512(page_writes + i + 8);
+
+        max_0 = _mm512_max_epu64(max_0, w_0);
+        max_1 = _mm512_max_epu64(max_1, w_1);
+        sum_0 = _mm512_add_epi64(sum_0, w_0);
+        sum_1 = _mm512_add_epi64(sum_1, w_1);
+    }
+
+    reduce_scalar(page_writes + i, n_pages - i, max_writes, sum_writes);
+
+    uint64_t max_vector = _mm512_reduce_max_epu64(_mm512_max_epu64(max_0,
+            max_1));
+    *max_writes = MAX(*max_writes, max_vector);
+    *sum_writes += _mm512_reduce_add_epi64(_mm512_add_epi64(sum_0, sum_1));
+}
+
+/*
+ * Picks the widest kernels the CPU supports, optionally capped by the
+ * ENDURER_ISA environment variable.
+ */
+static kernel_table_t
+select_kernels()
+{
+    const char* isa_cap = getenv("ENDURER_ISA");
+    bool allow_avx2 = isa_cap == nullptr or strcmp(isa_cap, "scalar") != 0;
+    bool allow_avx512 = isa_cap == nullptr or strcmp(isa_cap, "avx512") == 0;
+
+    __builtin_cpu_init();
+    if (allow_avx512 and __builtin_cpu_supports("avx512f") and
+            __builtin_cpu_supports("avx512dq")) {
+        return { apply_avx512, unapply_avx512, apply_narrow_avx512,
+                unapply_narrow_avx512, reduce_avx512 };
+    }
+    if (allow_avx2 and __builtin_cpu_supports("avx2")) {
+        return { apply_avx2, unapply_avx2, apply_narrow_avx2,
+                unapply_narrow_avx2, reduce_avx2 };
+    }
+
+    return { apply_scalar<uint64_t>, unapply_scalar<uint64_t>,
+            apply_scalar<uint32_t>, unapply_scalar<uint32_t>, reduce_scalar };
+}
+
+static const kernel_table_t&
+get_kernels()
+{
+    static const kernel_table_t kernels = select_kernels();
+    return kernels;
+}
+
+/*
+ * Returns a pointer to the given counter.
+ */
+static inline void*
+get_counter_ptr(counter_array_t counters, uint64_t counter_idx)
+{
+    if (counters.is_narrow) return (uint32_t*) counters.base + counter_idx;
+    return (uint64_t*) counters.base + counter_idx;
+}
+
+
+uint64_t
+apply_page_writes(counter_array_t counters, uint64_t first_counter,
+        const uint64_t* page_writes, size_t n_pages, uint64_t n_iters)
+{
+    auto& kernels = get_kernels();
+    auto apply = counters.is_narrow ? kernels.apply_narrow : kernels.apply;
+
+    return apply(get_counter_ptr(counters, first_counter), page_writes,
+            n_pages, n_iters);
+}
+
+void
+unapply_page_writes(counter_array_t counters, uint64_t first_counter,
+        const uint64_t* page_writes, size_t n_pages, uint64_t n_iters)
+{
+    auto& kernels = get_kernels();
+    auto unapply = counters.is_narrow ? kernels.unapply_narrow :
+            kernels.unapply;
+
+    unapply(get_counter_ptr(counters, first_counter), page_writes, n_pages,
+            n_iters);
+}
+
+void
+reduce_page_writes(const uint64_t* page_writes, size_t n_pages,
+        uint64_t* max_writes, uint64_t* sum_writes)
+{
+    get_kernels().reduce(page_writes, n_pages, max_writes, sum_writes);
+}
+
+/*
+ * Scatter-bound, so these are left scalar.
+ */
+template <typename counter_t>
+static uint64_t
+apply_sparse(counter_t* counters, const sparse_page_t* entries,
+        size_t n_entries, uint64_t first_page, uint64_t n_iters)
+{
+    uint64_t max_counter = 0;
+    for (size_t i = 0; i < n_entries; ++i) {
+        uint64_t counter = add_to_counter(counters[entries[i].page - first_page],
+                entries[i].writes * n_iters);
+        max_counter = MAX(max_counter, counter);
+    }
+
+    return max_counter;
+}
+
+template <typename counter_t>
+static void
+unapply_sparse(counter_t* counters, const sparse_page_t* entries,
+        size_t n_entries, uint64_t first_page, uint64_t n_iters)
+{
+    for (size_t i = 0; i < n_entries; ++i)
+        counters[entries[i].page - first_page] -= entries[i].writes * n_iters;
+}
+
+uint64_t
+apply_sparse_page_writes(counter_array_t counters, uint64_t first_counter,
+        const sparse_page_t* entries, size_t n_entries, uint64_t first_page,
+        uint64_t n_iters)
+{
+    void* counters_ptr = get_counter_ptr(counters, first_counter);
+
+    if (counters.is_narrow) {
+        return apply_sparse((uint32_t*) counters_ptr, entries, n_entries,
+                first_page, n_iters);
+    }
+    return apply_sparse((uint64_t*) counters_ptr, entries, n_entries,
+            first_page, n_iters);
+}
+
+void
+unapply_sparse_page_writes(counter_array_t counters, uint64_t first_counter,
+        const sparse_page_t* entries, size_t n_entries, uint64_t first_page,
+        uint64_t n_iters)
+{
+    void* counters_ptr = get_counter_ptr(counters, first_counter);
+
+    if (counters.is_narrow) {
+        unapply_sparse((uint32_t*) counters_ptr, entries, n_entries,
+                first_page, n_iters);
+    }
+    else {
+        unapply_sparse((uint64_t*) counters_ptr, entries, n_entries,
+                first_page, n_iters);
+    }
+}
+
+/*
+ * Only run to resolve a wearout, or once per FFT batch (whose transforms
+ * dominate), so this is left scalar.
+ */
+template <typename counter_t>
+static uint64_t
+get_iterations_until_threshold(const counter_t* counters,
+        const uint64_t* page_writes, size_t n_pages, uint64_t threshold)
+{
+    uint64_t n_iters = UINT64_MAX;
+    for (size_t i = 0; i < n_pages; ++i) {
+        if (counters[i] >= threshold) return 1;
+        if (page_writes[i] == 0) continue;
+
+        uint64_t headroom = threshold - counters[i];
+        n_iters = MIN(n_iters, (headroom + page_writes[i] - 1) / page_writes[i]);
+    }
+
+    return n_iters;
+}
+
+uint64_t
+get_iterations_until_threshold(counter_array_t counters,
+        uint64_t first_counter, const uint64_t* page_writes, size_t n_pages,
+        uint64_t threshold)
+{
+    void* counters_ptr = get_counter_ptr(counters, first_counter);
+
+    if (counters.is_narrow) {
+        return get_iterations_until_threshold((const uint32_t*) counters_ptr,
+                page_writes, n_pages, threshold);
+    }
+    return get_iterations_until_threshold((const uint64_t*) counters_ptr,
+            page_writes, n_pages, threshold);
+}
+
+/*
+ * Only run to re-tighten a sparse write set's bound (see
+ * Endurer::finish_pass()), after a full dense wearout check, so this is left
+ * scalar too.
+ */
+template <typename counter_t>
+static uint64_t
+get_max_counter(const counter_t* counters, size_t n_counters)
+{
+    uint64_t max_counter = 0;
+    for (size_t i = 0; i < n_counters; ++i)
+        max_counter = MAX(max_counter, (uint64_t) counters[i]);
+
+    return max_counter;
+}
+
+uint64_t
+get_max_counter(counter_array_t counters, uint64_t first_counter,
+        size_t n_counters)
+{
+    void* counters_ptr = get_counter_ptr(counters, first_counter);
+
+    if (counters.is_narrow)
+        return get_max_counter((const uint32_t*) counters_ptr, n_counters);
+    return get_max_counter((const uint64_t*) counters_ptr, n_counters);
+}
@@ -0,0 +1,82 @@
+/*
+ * Page-application kernels: the inner loops of the simulation, applied to a
+ * contiguous range of node memory counters and write-set entries (or, for
+ * reductions, to write-set entries alone).
+ * Vectorized (AVX2, AVX-512) variants are selected at runtime based on the
+ * host CPU, falling back to scalar code; setting ENDURER_ISA to "scalar",
+ * "avx2", or "avx512" restricts the selection.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * An array of page counters. Counters are 64 bits wide, or 32 bits wide
+ * ("narrow") for runs whose counters can't exceed that range. Narrow counters
+ * saturate at UINT32_MAX rather than wrapping, so a counter that overflows
+ * still reads as worn out; it can no longer be exactly unapplied, though,
+ * which is why callers only use them when saturation is unreachable.
+ */
+typedef struct {
+    void* base;
+    bool is_narrow;
+} counter_array_t;
+
+// a nonzero entry of a write set, in its sparse form
+typedef struct {
+    uint64_t page;
+    uint64_t writes;
+} sparse_page_t;
+
+/*
+ * Adds n_iters * page_writes[i] to counter first_counter + i for all i in
+ * [0, n_pages). Returns the largest resulting counter (0 if n_pages is 0).
+ */
+uint64_t apply_page_writes(counter_array_t counters, uint64_t first_counter,
+        const uint64_t* page_writes, size_t n_pages, uint64_t n_iters);
+
+/*
+ * Subtracts n_iters * page_writes[i] from counter first_counter + i, exactly
+ * undoing apply_page_writes().
+ */
+void unapply_page_writes(counter_array_t counters, uint64_t first_counter,
+        const uint64_t* page_writes, size_t n_pages, uint64_t n_iters);
+
+/*
+ * Sets *max_writes and *sum_writes to the largest and the sum of
+ * page_writes[i] for all i in [0, n_pages) (both 0 if n_pages is 0).
+ */
+void reduce_page_writes(const uint64_t* page_writes, size_t n_pages,
+        uint64_t* max_writes, uint64_t* sum_writes);
+
+/*
+ * Sparse counterparts of the above: for each of the n_entries entries, adds
+ * (resp. subtracts) n_iters * writes to counter
+ * first_counter + (page - first_page). apply_sparse_page_writes() returns the
+ * largest counter it wrote (0 if none).
+ */
+uint64_t apply_sparse_page_writes(counter_array_t counters,
+        uint64_t first_counter, const sparse_page_t* entries,
+        size_t n_entries, uint64_t first_page, uint64_t n_iters);
+void unapply_sparse_page_writes(counter_array_t counters,
+        uint64_t first_counter, const sparse_page_t* entries,
+        size_t n_entries, uint64_t first_page, uint64_t n_iters);
+
+/*
+ * Returns the smallest number of whole iterations after which some counter
+ * in [first_counter, first_counter + n_pages) reaches threshold: 1 if one
+ * already has, UINT64_MAX if none ever will.
+ */
+uint64_t get_iterations_until_threshold(counter_array_t counters,
+        uint64_t first_counter, const uint64_t* page_writes, size_t n_pages,
+        uint64_t threshold);
+
+/*
+ * Returns the largest counter in [first_counter, first_counter + n_counters)
+ * (0 if n_counters is 0).
+ */
+uint64_t get_max_counter(counter_array_t counters, uint64_t first_counter,
+        size_t n_counters);
+
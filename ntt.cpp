@@ -0,0 +1,153 @@
+#include <vector>
+
+#include "ntt.h"
+
+
+static constexpr uint64_t NTT_PRIMITIVE_ROOT = 3;
+
+/*
+ * Products are taken in Montgomery form (with R = 2^64), which needs no
+ * division: mont_mul(a, b) is a * b / R. Multiplying by a constant stored
+ * pre-multiplied by R (as the roots of unity are) thus yields a plain product.
+ */
+static constexpr uint64_t
+get_modulus_inverse()
+{
+    // Newton's iteration: each step doubles the number of correct low bits
+    uint64_t inverse = NTT_MODULUS;
+    for (int i = 0; i < 5; ++i) inverse *= 2 - NTT_MODULUS * inverse;
+    return inverse;
+}
+
+static constexpr uint64_t MODULUS_INVERSE = get_modulus_inverse();
+// R mod p, and R^2 mod p
+static constexpr uint64_t MONT_ONE = (uint64_t) (((unsigned __int128) 1 << 64) %
+        NTT_MODULUS);
+static constexpr uint64_t MONT_R2 = (uint64_t) ((unsigned __int128) MONT_ONE *
+        MONT_ONE % NTT_MODULUS);
+
+
+static inline uint64_t
+mont_mul(uint64_t a, uint64_t b)
+{
+    unsigned __int128 product = (unsigned __int128) a * b;
+    uint64_t m = (uint64_t) product * MODULUS_INVERSE;
+    uint64_t correction = ((unsigned __int128) m * NTT_MODULUS) >> 64;
+    uint64_t high = product >> 64;
+
+    // product - m * p is a multiple of R, within (-p * R, p * R)
+    return high >= correction ? high - correction :
+            high - correction + NTT_MODULUS;
+}
+
+static inline uint64_t
+mod_add(uint64_t a, uint64_t b)
+{
+    uint64_t sum = a + b;
+    return sum >= NTT_MODULUS ? sum - NTT_MODULUS : sum;
+}
+
+static inline uint64_t
+mod_sub(uint64_t a, uint64_t b)
+{
+    return a >= b ? a - b : a - b + NTT_MODULUS;
+}
+
+/*
+ * Returns base^exponent, all in Montgomery form.
+ */
+static uint64_t
+mont_pow(uint64_t base, uint64_t exponent)
+{
+    uint64_t result = MONT_ONE;
+    for (; exponent != 0; exponent >>= 1) {
+        if (exponent & 1) result = mont_mul(result, base);
+        base = mont_mul(base, base);
+    }
+    return result;
+}
+
+/*
+ * Returns the roots of unity used by a length-n transform, in Montgomery
+ * form, packed so that roots[h + j] is w_2h^j for each half-length h: a
+ * transform's butterflies at any level then read them contiguously.
+ */
+static std::vector<uint64_t>
+get_roots(size_t n, bool inverse)
+{
+    std::vector<uint64_t> roots(n);
+    if (n < 2) return roots;
+
+    uint64_t generator = mont_mul(NTT_PRIMITIVE_ROOT, MONT_R2);
+    uint64_t root = mont_pow(generator, (NTT_MODULUS - 1) / n);
+    if (inverse) root = mont_pow(root, NTT_MODULUS - 2);
+
+    size_t half_n = n / 2;
+    roots[half_n] = MONT_ONE;
+    for (size_t j = 1; j < half_n; ++j)
+        roots[half_n + j] = mont_mul(roots[half_n + j - 1], root);
+    for (size_t h = half_n / 2; h != 0; h /= 2) {
+        for (size_t j = 0; j < h; ++j) roots[h + j] = roots[2 * (h + j)];
+    }
+
+    return roots;
+}
+
+/*
+ * Decimation in frequency (Gentleman-Sande).
+ */
+void
+ntt_forward(uint64_t* values, size_t n)
+{
+    auto roots = get_roots(n, false);
+
+    for (size_t len = n; len >= 2; len /= 2) {
+        size_t h = len / 2;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t j = 0; j < h; ++j) {
+                uint64_t u = values[i + j];
+                uint64_t v = values[i + j + h];
+                values[i + j] = mod_add(u, v);
+                values[i + j + h] = mont_mul(mod_sub(u, v), roots[h + j]);
+            }
+        }
+    }
+}
+
+/*
+ * Decimation in time (Cooley-Tukey), with the 1/n scaling folded into the
+ * final pass over the values.
+ */
+void
+ntt_inverse(uint64_t* values, size_t n)
+{
+    auto roots = get_roots(n, true);
+
+    for (size_t len = 2; len <= n; len *= 2) {
+        size_t h = len / 2;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t j = 0; j < h; ++j) {
+                uint64_t u = values[i + j];
+                uint64_t v = mont_mul(values[i + j + h], roots[h + j]);
+                values[i + j] = mod_add(u, v);
+                values[i + j + h] = mod_sub(u, v);
+            }
+        }
+    }
+
+    // n^-1 in Montgomery form (p - 1 is divisible by n, so n^-1 is
+    // (p - 1) / n * -1 = p - (p - 1) / n)
+    uint64_t n_inverse = mont_mul(NTT_MODULUS - (NTT_MODULUS - 1) / n,
+            MONT_R2);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = mont_mul(values[i], n_inverse);
+}
+
+void
+ntt_multiply_add(uint64_t* acc, const uint64_t* a, const uint64_t* b,
+        size_t n)
+{
+    // a * b / R, then * R^2 / R
+    for (size_t i = 0; i < n; ++i)
+        acc[i] = mod_add(acc[i], mont_mul(mont_mul(a[i], b[i]), MONT_R2));
+}
@@ -0,0 +1,34 @@
+/*
+ * Number-theoretic transforms: FFTs over the integers modulo a prime, rather
+ * than over the complex numbers, so that convolutions computed with them are
+ * exact (as long as every true result is below the modulus).
+ * Transforms are in-place, of power-of-two lengths up to 2^57; values are
+ * taken and returned in [0, NTT_MODULUS).
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// 29 * 2^57 + 1 (with primitive root 3)
+static constexpr uint64_t NTT_MODULUS = 4179340454199820289ull;
+
+/*
+ * Forward transform: takes values in natural order, and leaves the transform
+ * in bit-reversed order (which is all pointwise products need).
+ */
+void ntt_forward(uint64_t* values, size_t n);
+
+/*
+ * Inverse of ntt_forward(): takes a transform in bit-reversed order, and
+ * leaves the values in natural order.
+ */
+void ntt_inverse(uint64_t* values, size_t n);
+
+/*
+ * Sets acc[i] to acc[i] + a[i] * b[i] (modulo NTT_MODULUS), for all i in
+ * [0, n).
+ */
+void ntt_multiply_add(uint64_t* acc, const uint64_t* a, const uint64_t* b,
+        size_t n);
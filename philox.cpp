@@ -0,0 +1,54 @@
+#include "philox.h"
+
+
+static constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+static constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+static constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+static constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+static constexpr int PHILOX_N_ROUNDS = 10;
+
+
+static inline void
+philox_round(uint32_t ctr[4], const uint32_t key[2])
+{
+    uint64_t product_0 = (uint64_t) PHILOX_M0 * ctr[0];
+    uint64_t product_1 = (uint64_t) PHILOX_M1 * ctr[2];
+
+    uint32_t next[4] = {
+        (uint32_t) (product_1 >> 32) ^ ctr[1] ^ key[0],
+        (uint32_t) product_1,
+        (uint32_t) (product_0 >> 32) ^ ctr[3] ^ key[1],
+        (uint32_t) product_0,
+    };
+    for (int i = 0; i < 4; ++i) ctr[i] = next[i];
+}
+
+uint64_t
+philox_u64(uint64_t counter_hi, uint64_t counter_lo, uint64_t key)
+{
+    uint32_t ctr[4] = { (uint32_t) counter_lo, (uint32_t) (counter_lo >> 32),
+            (uint32_t) counter_hi, (uint32_t) (counter_hi >> 32) };
+    uint32_t k[2] = { (uint32_t) key, (uint32_t) (key >> 32) };
+
+    for (int round = 0; round < PHILOX_N_ROUNDS; ++round) {
+        if (round != 0) {
+            k[0] += PHILOX_W0;
+            k[1] += PHILOX_W1;
+        }
+        philox_round(ctr, k);
+    }
+
+    return ((uint64_t) ctr[1] << 32) | ctr[0];
+}
+
+/*
+ * Scales by a 64x64->128-bit multiply rather than taking a modulus; the bias
+ * is at most bound / 2^64.
+ */
+uint64_t
+philox_bounded(uint64_t counter_hi, uint64_t counter_lo, uint64_t key,
+        uint64_t bound)
+{
+    uint64_t bits = philox_u64(counter_hi, counter_lo, key);
+    return (uint64_t) (((unsigned __int128) bits * bound) >> 64);
+}
@@ -0,0 +1,22 @@
+/*
+ * Philox4x32-10, a counter-based PRNG (Salmon et al., SC '11): each output is
+ * a pure function of a 128-bit counter and a 64-bit key, so independent
+ * streams (one per key) can be drawn from in any order, by any thread, with
+ * the same results.
+ */
+#pragma once
+
+#include <stdint.h>
+
+
+/*
+ * Returns 64 random bits for the given counter and key.
+ */
+uint64_t philox_u64(uint64_t counter_hi, uint64_t counter_lo, uint64_t key);
+
+/*
+ * Returns a random value uniformly in [0, bound), for the given counter and
+ * key (bound must be nonzero).
+ */
+uint64_t philox_bounded(uint64_t counter_hi, uint64_t counter_lo, uint64_t key,
+        uint64_t bound);
@@ -0,0 +1,163 @@
+#include <sys/mman.h>
+
+#include "util.h"
+#include "range_max_tree.h"
+
+
+/*
+ * Reserves room for a complete tree (at most 2 * n_leaves - 1 nodes), but
+ * only the nodes actually created are ever touched. The root covers
+ * [0, n_leaves), with the values padded out to a power of two.
+ */
+RangeMaxTree::RangeMaxTree(uint64_t n_values)
+{
+    n_leaves = 1;
+    while (n_leaves < n_values) n_leaves *= 2;
+
+    nodes_size = 2 * n_leaves * sizeof(tree_node_t);
+    void* mapping = mmap(nullptr, nodes_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED)
+        print_message_and_die("could not allocate range tree");
+
+    nodes = (tree_node_t*) mapping;
+    n_nodes = 2;
+}
+
+RangeMaxTree::~RangeMaxTree()
+{
+    munmap(nodes, nodes_size);
+}
+
+/*
+ * Adds value to every value in [first, end).
+ */
+void
+RangeMaxTree::add(uint64_t first, uint64_t end, uint64_t value)
+{
+    if (first < end) update(1, 0, n_leaves, first, end, value, true);
+}
+
+/*
+ * Subtracts value from every value in [first, end), exactly undoing an
+ * add(first, end, value).
+ */
+void
+RangeMaxTree::subtract(uint64_t first, uint64_t end, uint64_t value)
+{
+    if (first < end) update(1, 0, n_leaves, first, end, value, false);
+}
+
+/*
+ * Returns the largest value in [first, end) (0 if the range is empty).
+ */
+uint64_t
+RangeMaxTree::get_max(uint64_t first, uint64_t end)
+{
+    return first < end ? get_max(1, 0, n_leaves, first, end) : 0;
+}
+
+/*
+ * Calls fn(range_first, range_end, value) for each range of equal values
+ * within [first, end), in order (clipped to it). Ranges split across tree
+ * nodes are reported piecewise.
+ */
+void
+RangeMaxTree::for_each_range(uint64_t first, uint64_t end,
+        const std::function<void(uint64_t, uint64_t, uint64_t)>& fn)
+{
+    for_each_range(1, 0, n_leaves, 0, first, end, fn);
+}
+
+/*
+ * Returns the bytes taken up by the nodes created so far.
+ */
+size_t
+RangeMaxTree::get_size()
+{
+    return n_nodes * sizeof(tree_node_t);
+}
+
+/*
+ * Returns the left child of the given inner node, first creating both of its
+ * children (all 0, as the mapping is zero-filled) if it has none yet.
+ */
+inline uint64_t
+RangeMaxTree::get_children(uint64_t node)
+{
+    if (nodes[node].children == 0) {
+        nodes[node].children = n_nodes;
+        n_nodes += 2;
+    }
+    return nodes[node].children;
+}
+
+void
+RangeMaxTree::update(uint64_t node, uint64_t node_first, uint64_t node_end,
+        uint64_t first, uint64_t end, uint64_t value, bool is_add)
+{
+    if (end <= node_first or node_end <= first) return;
+
+    auto& tree_node = nodes[node];
+    if (first <= node_first and node_end <= end) {
+        if (is_add) {
+            tree_node.max += value;
+            tree_node.pending += value;
+        }
+        else {
+            tree_node.max -= value;
+            tree_node.pending -= value;
+        }
+        return;
+    }
+
+    uint64_t children = get_children(node);
+    uint64_t node_mid = node_first + (node_end - node_first) / 2;
+    update(children, node_first, node_mid, first, end, value, is_add);
+    update(children + 1, node_mid, node_end, first, end, value, is_add);
+
+    tree_node.max = tree_node.pending +
+            MAX(nodes[children].max, nodes[children + 1].max);
+}
+
+uint64_t
+RangeMaxTree::get_max(uint64_t node, uint64_t node_first, uint64_t node_end,
+        uint64_t first, uint64_t end)
+{
+    // (values are never negative, so 0 stands in for an empty range)
+    if (end <= node_first or node_end <= first) return 0;
+
+    // a node without children has every value in its range equal
+    auto& tree_node = nodes[node];
+    if ((first <= node_first and node_end <= end) or tree_node.children == 0)
+        return tree_node.max;
+
+    uint64_t children = tree_node.children;
+    uint64_t node_mid = node_first + (node_end - node_first) / 2;
+    uint64_t left_max = get_max(children, node_first, node_mid, first, end);
+    uint64_t right_max = get_max(children + 1, node_mid, node_end, first,
+            end);
+
+    return tree_node.pending + MAX(left_max, right_max);
+}
+
+void
+RangeMaxTree::for_each_range(uint64_t node, uint64_t node_first,
+        uint64_t node_end, uint64_t base, uint64_t first, uint64_t end,
+        const std::function<void(uint64_t, uint64_t, uint64_t)>& fn)
+{
+    if (end <= node_first or node_end <= first) return;
+
+    auto& tree_node = nodes[node];
+    uint64_t value = base + tree_node.pending;
+    if (tree_node.children == 0) {
+        fn(MAX(first, node_first), MIN(end, node_end), value);
+        return;
+    }
+
+    uint64_t node_mid = node_first + (node_end - node_first) / 2;
+    for_each_range(tree_node.children, node_first, node_mid, value, first,
+            end, fn);
+    for_each_range(tree_node.children + 1, node_mid, node_end, value, first,
+            end, fn);
+}
@@ -0,0 +1,57 @@
+/*
+ * A segment tree over an array of values (initially all 0) that adds to a
+ * range of them, or finds the largest in a range, in O(log n) time. Adds are
+ * kept lazily: each tree node holds what was added to its whole range but not
+ * yet below it, and the largest value in its range. Nothing is ever pushed
+ * down, so subtract() exactly undoes the add() of the same range.
+ * Tree nodes are only created where an add splits a node's range (the rest
+ * of the tree is implicitly all 0), out of a lazily zero-filled mapping, so
+ * a tree over a huge memory costs a few nodes per range added, not per value.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+
+class RangeMaxTree {
+    public:
+        RangeMaxTree(uint64_t n_values);
+        RangeMaxTree(const RangeMaxTree& t) = delete;
+        RangeMaxTree& operator=(const RangeMaxTree& t) = delete;
+        RangeMaxTree(RangeMaxTree&& t) = delete;
+        RangeMaxTree& operator=(RangeMaxTree&& t) = delete;
+        ~RangeMaxTree();
+
+        void add(uint64_t first, uint64_t end, uint64_t value);
+        void subtract(uint64_t first, uint64_t end, uint64_t value);
+        uint64_t get_max(uint64_t first, uint64_t end);
+        void for_each_range(uint64_t first, uint64_t end,
+                const std::function<void(uint64_t, uint64_t, uint64_t)>& fn);
+        size_t get_size();
+
+    private:
+        void update(uint64_t node, uint64_t node_first, uint64_t node_end,
+                uint64_t first, uint64_t end, uint64_t value, bool is_add);
+        uint64_t get_max(uint64_t node, uint64_t node_first,
+                uint64_t node_end, uint64_t first, uint64_t end);
+
+        void for_each_range(uint64_t node, uint64_t node_first,
+                uint64_t node_end, uint64_t base, uint64_t first, uint64_t end,
+                const std::function<void(uint64_t, uint64_t, uint64_t)>& fn);
+
+        uint64_t get_children(uint64_t node);
+
+        struct tree_node_t {
+            uint64_t max;               // largest value in the node's range
+            uint64_t pending;           // added to all of it, not yet below
+            uint64_t children;          // left child (right is next); 0: none
+        };
+
+        uint64_t n_leaves;              // a power of two
+        tree_node_t* nodes;             // node 0 is unused, node 1 the root
+        uint64_t n_nodes;
+        size_t nodes_size;
+};
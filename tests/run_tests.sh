@@ -0,0 +1,93 @@
+#!/bin/sh
+#
+# Runs the tests (after "make test" builds them): the kernel checks under
+# each ISA the CPU supports (unsupported ones fall back to a narrower ISA,
+# and so are checked anyway), the Philox known-answer checks, checks that
+# endurer refuses 32-bit counters (-w 32) that could overflow, and checks of
+# endurer's iteration counts on small write sets against known values.
+#
+# Usage: ./tests/run_tests.sh
+
+set -e
+
+BIN_DIR="$(dirname "$0")/../bin"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+n_failures=0
+fail() {
+    echo "FAIL: $1" >&2
+    n_failures=$((n_failures + 1))
+}
+
+for isa in scalar avx2 avx512; do
+    ENDURER_ISA=$isa "$BIN_DIR/test_kernels" || fail "kernels ($isa)"
+done
+"$BIN_DIR/test_philox" || fail "philox"
+
+# runs endurer with 32-bit counters (-w 32) on a write set of 4096 pages of
+# 0-3 writes and a page of the given number of writes, with the given
+# endurance (and a remap period long enough that the run ends right away);
+# succeeds if it refuses to
+refuses_narrow() {
+    perl -e 'print pack("Q<*", (map { $_ % 4 } 0 .. 4095), $ARGV[0])' "$1" \
+            > "$WORK_DIR/write_set.bin"
+    ! "$BIN_DIR/endurer" -m write -p 4096 -c "$2" -r 1000000000000 -t 1 -j 1 \
+            -i "$WORK_DIR/write_set.bin" -w 32 > /dev/null \
+            2> "$WORK_DIR/stderr.txt" &&
+            grep -q "32-bit counters could overflow" "$WORK_DIR/stderr.txt"
+}
+
+# the endurance plus a pass's worth of slack must fit in 32 bits
+refuses_narrow 3 1000 && fail "-w 32 refused with a small endurance"
+refuses_narrow 3 2147483647 && fail "-w 32 refused with endurance 2^31 - 1"
+refuses_narrow 3 2147483648 || fail "-w 32 taken with endurance 2^31"
+refuses_narrow 3 4294967296 || fail "-w 32 taken with endurance 2^32"
+refuses_narrow 4294967295 1000 || fail "-w 32 taken with 2^32 - 1 page writes"
+
+# writes a 4096-page write set of the given kind to $WORK_DIR/<kind>.bin:
+# dense (0-4 writes on every page), sparse (1-7 writes on one page in 50), or
+# blocky (runs of 256 pages of 0-2 writes, applied a run at a time)
+make_write_set() {
+    case $1 in
+        dense) expr='($_ * 7919) % 5' ;;
+        sparse) expr='$_ % 50 == 0 ? 1 + $_ % 7 : 0' ;;
+        blocky) expr='int($_ / 256) % 3' ;;
+    esac
+    perl -e "print pack('Q<*', map { $expr } 0 .. 4095)" > "$WORK_DIR/$1.bin"
+}
+
+# prints the iterations endurer runs on the given write set (with a fixed
+# configuration), given any further arguments
+iterations() {
+    ws="$1"
+    shift
+    "$BIN_DIR/endurer" -m write -p 4096 -c 3000 -r 100 -t 1 -j 2 \
+            -i "$WORK_DIR/$ws.bin" "$@" 2> /dev/null |
+            sed -n 's/^n\. iterations: //p'
+}
+
+# iterations must match known values, however they are reached: pass by pass,
+# by FFT batches, or resumed from the last of a run's checkpoints
+for known in dense:1225 sparse:12597 blocky:2450; do
+    ws=${known%:*}
+    expected=${known#*:}
+    make_write_set $ws
+
+    [ "$(iterations $ws)" = $expected ] || fail "$ws iterations"
+    [ "$(iterations $ws --fft-batch 8)" = $expected ] ||
+            fail "$ws iterations with --fft-batch"
+
+    checkpoint="$WORK_DIR/$ws.ckpt"
+    [ "$(iterations $ws --checkpoint "$checkpoint" \
+            --checkpoint-interval 0)" = $expected ] ||
+            fail "$ws iterations while checkpointing"
+    [ "$(iterations $ws --checkpoint "$checkpoint" --resume)" = $expected ] ||
+            fail "$ws iterations after --resume"
+done
+
+if [ $n_failures -ne 0 ]; then
+    echo "$n_failures tests failed" >&2
+    exit 1
+fi
+echo "all tests passed"
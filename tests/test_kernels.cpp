@@ -0,0 +1,142 @@
+/*
+ * Checks the page-application kernels of whichever ISA ENDURER_ISA selects
+ * (see kernels.h) on counters at and near UINT32_MAX: narrow counters must
+ * saturate there, and apply/unapply must round-trip exactly short of it,
+ * for wide counters as well. Array lengths aren't multiples of any vector
+ * width, so that the scalar tails are covered too. Exits nonzero on any
+ * mismatch.
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "../kernels.h"
+
+
+static unsigned n_failures = 0;
+
+static void
+check(bool ok, const char* what, size_t i, uint64_t actual, uint64_t expected)
+{
+    if (ok) return;
+    fprintf(stderr, "FAIL: %s [%zu]: got %lu, expected %lu\n", what, i,
+            actual, expected);
+    ++n_failures;
+}
+
+/*
+ * A write set of n_pages entries of 0 to max_writes writes, varying page by
+ * page.
+ */
+static std::vector<uint64_t>
+make_page_writes(size_t n_pages, uint64_t max_writes)
+{
+    std::vector<uint64_t> page_writes(n_pages);
+    for (size_t i = 0; i < n_pages; ++i)
+        page_writes[i] = (i * 7919) % (max_writes + 1);
+
+    return page_writes;
+}
+
+/*
+ * Applies and unapplies a write set to counters starting just short of
+ * UINT32_MAX, never reaching it: every counter must hold the exact sum in
+ * between, and its starting value afterwards.
+ */
+template <typename counter_t>
+static void
+test_round_trip(size_t n_pages)
+{
+    const char* what = sizeof(counter_t) == 4 ? "narrow round trip" :
+            "wide round trip";
+    const uint64_t n_iters = 13;
+    auto page_writes = make_page_writes(n_pages, 50);
+
+    // wide counters start over UINT32_MAX, too, so that sums cross it
+    std::vector<counter_t> counters(n_pages);
+    for (size_t i = 0; i < n_pages; ++i) {
+        counters[i] = UINT32_MAX - n_iters * 50 - i;
+        if (sizeof(counter_t) == 8 and i % 2 == 1) counters[i] += 100;
+    }
+    std::vector<counter_t> start = counters;
+    counter_array_t array = { counters.data(), sizeof(counter_t) == 4 };
+
+    uint64_t max_counter = apply_page_writes(array, 0, page_writes.data(),
+            n_pages, n_iters);
+    uint64_t expected_max = 0;
+    for (size_t i = 0; i < n_pages; ++i) {
+        uint64_t expected = start[i] + page_writes[i] * n_iters;
+        check(counters[i] == expected, what, i, counters[i], expected);
+        if (expected > expected_max) expected_max = expected;
+    }
+    check(max_counter == expected_max, what, n_pages, max_counter,
+            expected_max);
+
+    unapply_page_writes(array, 0, page_writes.data(), n_pages, n_iters);
+    for (size_t i = 0; i < n_pages; ++i)
+        check(counters[i] == start[i], what, i, counters[i], start[i]);
+}
+
+/*
+ * Applies a write set to narrow counters at and near UINT32_MAX, with
+ * increments of up to 2^40: every counter that would pass UINT32_MAX must
+ * read exactly UINT32_MAX, and every other the exact sum.
+ */
+static void
+test_narrow_saturation(size_t n_pages)
+{
+    auto page_writes = make_page_writes(n_pages, 3);
+    page_writes[n_pages / 2] = (uint64_t) 1 << 20;
+
+    for (uint64_t n_iters : { 1ul, 4ul, 1ul << 20 }) {
+        std::vector<uint32_t> counters(n_pages);
+        for (size_t i = 0; i < n_pages; ++i) counters[i] = UINT32_MAX - i % 8;
+        std::vector<uint32_t> start = counters;
+        counter_array_t array = { counters.data(), true };
+
+        uint64_t max_counter = apply_page_writes(array, 0, page_writes.data(),
+                n_pages, n_iters);
+        uint64_t expected_max = 0;
+        for (size_t i = 0; i < n_pages; ++i) {
+            uint64_t expected = start[i] + page_writes[i] * n_iters;
+            if (expected > UINT32_MAX) expected = UINT32_MAX;
+            check(counters[i] == expected, "narrow saturation", i,
+                    counters[i], expected);
+            if (expected > expected_max) expected_max = expected;
+        }
+        check(max_counter == expected_max, "narrow saturation", n_pages,
+                max_counter, expected_max);
+    }
+
+    // the sparse kernels saturate the same way
+    std::vector<uint32_t> counters(n_pages, UINT32_MAX - 2);
+    std::vector<sparse_page_t> entries;
+    for (size_t i = 0; i < n_pages; i += 3) entries.push_back({ i, i % 5 });
+    counter_array_t array = { counters.data(), true };
+
+    apply_sparse_page_writes(array, 0, entries.data(), entries.size(), 0, 1);
+    for (auto& entry : entries) {
+        uint64_t expected = UINT32_MAX - 2 + entry.writes;
+        if (expected > UINT32_MAX) expected = UINT32_MAX;
+        check(counters[entry.page] == expected, "sparse narrow saturation",
+                entry.page, counters[entry.page], expected);
+    }
+}
+
+int
+main()
+{
+    for (size_t n_pages : { 1, 7, 37, 1003 }) {
+        test_round_trip<uint32_t>(n_pages);
+        test_round_trip<uint64_t>(n_pages);
+        test_narrow_saturation(n_pages);
+    }
+
+    if (n_failures != 0) {
+        fprintf(stderr, "%u kernel checks failed\n", n_failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Checks philox_u64() against the Philox4x32-10 known-answer vectors of the
+ * Random123 reference implementation (kat_vectors), of which it returns the
+ * first two output words (as the low and high halves), and philox_bounded()
+ * against the scaling it documents. Exits nonzero on any mismatch.
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include <initializer_list>
+
+#include "../philox.h"
+
+
+// counter and key words as in Random123 (word 0 first), and output words 0-1
+typedef struct {
+    uint32_t ctr[4];
+    uint32_t key[2];
+    uint32_t out[2];
+} philox_kat_t;
+
+static constexpr philox_kat_t PHILOX_KATS[] = {
+    { { 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+            { 0x00000000, 0x00000000 }, { 0x6627e8d5, 0xe169c58d } },
+    { { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+            { 0xffffffff, 0xffffffff }, { 0x408f276d, 0x41c83b0e } },
+    { { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+            { 0xa4093822, 0x299f31d0 }, { 0xd16cfe09, 0x94fdcceb } },
+};
+
+static uint64_t
+join(uint32_t lo, uint32_t hi)
+{
+    return ((uint64_t) hi << 32) | lo;
+}
+
+int
+main()
+{
+    unsigned n_failures = 0;
+
+    for (auto& kat : PHILOX_KATS) {
+        uint64_t actual = philox_u64(join(kat.ctr[2], kat.ctr[3]),
+                join(kat.ctr[0], kat.ctr[1]), join(kat.key[0], kat.key[1]));
+        uint64_t expected = join(kat.out[0], kat.out[1]);
+        if (actual == expected) continue;
+
+        fprintf(stderr, "FAIL: philox_u64 for counter word 0 %#x: got %#lx, "
+                "expected %#lx\n", kat.ctr[0], actual, expected);
+        ++n_failures;
+    }
+
+    // bounded draws are the top bits of the full one, scaled to the bound
+    for (uint64_t bound : { 1ul, 6ul, 1ul << 32, 1ul << 63, UINT64_MAX }) {
+        for (uint64_t counter = 0; counter < 64; ++counter) {
+            uint64_t bits = philox_u64(0, counter, 8);
+            uint64_t expected = ((unsigned __int128) bits * bound) >> 64;
+            uint64_t actual = philox_bounded(0, counter, 8, bound);
+            if (actual == expected and actual < bound) continue;
+
+            fprintf(stderr, "FAIL: philox_bounded for bound %#lx: got %#lx, "
+                    "expected %#lx\n", bound, actual, expected);
+            ++n_failures;
+        }
+    }
+
+    if (n_failures != 0) {
+        fprintf(stderr, "%u Philox checks failed\n", n_failures);
+        return 1;
+    }
+
+    return 0;
+}
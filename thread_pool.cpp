@@ -0,0 +1,147 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include "thread_pool.h"
+
+
+/*
+ * The calling thread participates in every batch (as thread 0), so
+ * n_threads - 1 workers are spawned. If pin_threads is set, thread i is pinned
+ * to the i-th CPU (modulo) this process may run on.
+ */
+ThreadPool::ThreadPool(uint32_t n_threads, bool pin_threads) :
+        pin_threads(pin_threads)
+{
+    if (pin_threads) {
+        cpu_set_t cpus;
+        sched_getaffinity(0, sizeof(cpus), &cpus);
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpus)) allowed_cpus.push_back(cpu);
+        }
+        pin_to_cpu(0);
+    }
+
+    for (uint32_t i = 1; i < n_threads; ++i)
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        should_exit = true;
+    }
+    batch_start_cv.notify_all();
+
+    for (auto& w : workers) w.join();
+}
+
+uint32_t
+ThreadPool::get_n_threads()
+{
+    return workers.size() + 1;
+}
+
+void
+ThreadPool::pin_to_cpu(uint32_t thread_idx)
+{
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(allowed_cpus[thread_idx % allowed_cpus.size()], &cpu);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+}
+
+/*
+ * Runs this thread's contiguous share of the current batch's tasks or, for a
+ * dynamic batch, claims and runs tasks until none are left.
+ */
+void
+ThreadPool::run_tasks(uint32_t thread_idx)
+{
+    if (is_dynamic) {
+        size_t i;
+        while ((i = next_task_idx.fetch_add(1)) < n_tasks) (*task)(i);
+        return;
+    }
+
+    uint32_t n_threads = get_n_threads();
+    size_t first_task_idx = n_tasks * thread_idx / n_threads;
+    size_t last_task_idx = n_tasks * (thread_idx + 1) / n_threads;
+
+    for (size_t i = first_task_idx; i < last_task_idx; ++i) (*task)(i);
+}
+
+void
+ThreadPool::worker_loop(uint32_t thread_idx)
+{
+    if (pin_threads) pin_to_cpu(thread_idx);
+
+    uint64_t seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            batch_start_cv.wait(lock, [&] {
+                return should_exit or batch_generation != seen_generation;
+            });
+            if (should_exit) return;
+            seen_generation = batch_generation;
+        }
+
+        run_tasks(thread_idx);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--n_workers_busy == 0) batch_done_cv.notify_one();
+        }
+    }
+}
+
+/*
+ * Runs task(i) for all i in [0, n_tasks), in no particular order, and waits
+ * for all of them to finish.
+ */
+void
+ThreadPool::parallel_for(size_t n_tasks,
+        const std::function<void(size_t)>& task)
+{
+    run_batch(n_tasks, task, false);
+}
+
+/*
+ * As parallel_for(), but tasks are claimed in index order by whichever thread
+ * next becomes free, so long tasks don't hold up a thread's whole share.
+ */
+void
+ThreadPool::parallel_for_dynamic(size_t n_tasks,
+        const std::function<void(size_t)>& task)
+{
+    run_batch(n_tasks, task, true);
+}
+
+void
+ThreadPool::run_batch(size_t n_tasks, const std::function<void(size_t)>& task,
+        bool is_dynamic)
+{
+    if (workers.empty()) {
+        for (size_t i = 0; i < n_tasks; ++i) task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->n_tasks = n_tasks;
+        this->is_dynamic = is_dynamic;
+        next_task_idx = 0;
+        n_workers_busy = workers.size();
+        ++batch_generation;
+    }
+    batch_start_cv.notify_all();
+
+    run_tasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    batch_done_cv.wait(lock, [&] { return n_workers_busy == 0; });
+}
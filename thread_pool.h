@@ -0,0 +1,63 @@
+/*
+ * A fixed pool of worker threads that run batches of independent tasks.
+ * Each parallel_for() call is a barrier: it returns only once every task in
+ * the batch has completed, so callers can reduce per-task results afterwards.
+ * Tasks are statically partitioned into contiguous shares, one per thread in
+ * order: with as many tasks as threads, task i runs on thread i, so callers
+ * can give each thread a stable share of data of their own choosing.
+ * parallel_for_dynamic() instead hands tasks out one at a time to whichever
+ * thread is free, for batches of few, long, and uneven tasks.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool {
+    public:
+        ThreadPool(uint32_t n_threads, bool pin_threads);
+        ThreadPool(const ThreadPool& tp) = delete;
+        ThreadPool& operator=(const ThreadPool& tp) = delete;
+        ThreadPool(ThreadPool&& tp) = delete;
+        ThreadPool& operator=(ThreadPool&& tp) = delete;
+        ~ThreadPool();
+
+        void parallel_for(size_t n_tasks,
+                const std::function<void(size_t)>& task);
+        void parallel_for_dynamic(size_t n_tasks,
+                const std::function<void(size_t)>& task);
+        uint32_t get_n_threads();
+
+    private:
+        void run_batch(size_t n_tasks, const std::function<void(size_t)>& task,
+                bool is_dynamic);
+        void worker_loop(uint32_t thread_idx);
+        void run_tasks(uint32_t thread_idx);
+        void pin_to_cpu(uint32_t thread_idx);
+
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable batch_start_cv;
+        std::condition_variable batch_done_cv;
+        uint64_t batch_generation = 0;
+        uint32_t n_workers_busy = 0;
+        bool should_exit = false;
+
+        // the current batch
+        const std::function<void(size_t)>* task = nullptr;
+        size_t n_tasks = 0;
+        bool is_dynamic = false;
+        std::atomic<size_t> next_task_idx;
+
+        bool pin_threads;
+        std::vector<int> allowed_cpus;
+};
@@ -15,3 +15,14 @@ print_message_and_die(const char* format, ...)
     va_end(argptr);
     exit(1);
 }
+
+void
+print_warning(const char* format, ...)
+{
+    va_list argptr;
+    va_start(argptr, format);
+    fprintf(stderr, "WARNING: ");
+    vfprintf(stderr, format, argptr);
+    fprintf(stderr, "\n");
+    va_end(argptr);
+}
@@ -4,6 +4,7 @@
 #pragma once
 
 void print_message_and_die(const char* format, ...);
+void print_warning(const char* format, ...);
 
-#define MAX(a, b) (a > b ? a : b)
-#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "write_set_file.h"
+
+
+void
+read_write_set_file_info(int fd, size_t file_size,
+        write_set_file_info_t* info)
+{
+    write_set_header_t header;
+    bool is_container = file_size >= sizeof(header) and
+            pread_all(fd, &header, sizeof(header), 0) and
+            memcmp(header.magic, WRITE_SET_MAGIC, sizeof(header.magic)) == 0;
+
+    if (!is_container) {
+        if (file_size % sizeof(uint64_t) != 0)
+                print_message_and_die("malformed input file; its size should "
+                "be a multiple of %zu", sizeof(uint64_t));
+
+        *info = { file_size / sizeof(uint64_t), 0, 0, 0, 0, 0 };
+        return;
+    }
+
+    if (header.byte_order != WRITE_SET_BYTE_ORDER)
+        print_message_and_die("input file was written in another byte order");
+    if (header.version != WRITE_SET_VERSION)
+        print_message_and_die("input file is of unsupported version %u",
+                header.version);
+    if (header.entry_bits != 64)
+        print_message_and_die("input file has %u-bit entries; only 64-bit "
+                "ones are supported", header.entry_bits);
+
+    // (bound the metadata by the file before reading it in)
+    if (header.metadata_size > file_size - sizeof(header))
+        print_message_and_die("input file header is corrupt");
+    std::string metadata(header.metadata_size, '\0');
+    if (!pread_all(fd, &metadata[0], metadata.size(), sizeof(header)) or
+            get_write_set_header_checksum(header, metadata) !=
+            header.header_checksum)
+        print_message_and_die("input file header is corrupt");
+
+    // (a corrupt header could make the layout's arithmetic wrap around)
+    uint64_t payload_size, payload_end;
+    if (__builtin_mul_overflow(header.n_pages, sizeof(uint64_t),
+            &payload_size) or __builtin_add_overflow(header.payload_offset,
+            payload_size, &payload_end))
+        print_message_and_die("input file layout is malformed");
+    bool layout_ok = header.n_pages != 0 and
+            header.payload_offset % WRITE_SET_PAYLOAD_ALIGNMENT == 0 and
+            header.payload_offset >= sizeof(header) + header.metadata_size and
+            payload_end <= file_size;
+
+    uint64_t block_n_pages = header.checksum_block_n_pages;
+    if (block_n_pages != 0) {
+        uint64_t n_blocks = header.n_pages / block_n_pages +
+                (header.n_pages % block_n_pages != 0);
+        uint64_t checksums_size, checksums_end;
+        if (__builtin_mul_overflow(n_blocks, sizeof(uint64_t),
+                &checksums_size) or __builtin_add_overflow(
+                header.checksums_offset, checksums_size, &checksums_end))
+            print_message_and_die("input file layout is malformed");
+        layout_ok = layout_ok and (block_n_pages & (block_n_pages - 1)) == 0 and
+                block_n_pages <= WRITE_SET_MAX_CHECKSUM_BLOCK_N_PAGES and
+                header.checksums_offset >= payload_end and
+                checksums_end <= file_size;
+    }
+    if (!layout_ok) print_message_and_die("input file layout is malformed");
+
+    *info = { header.n_pages, header.payload_offset, header.page_size,
+            header.time_units, header.checksum_block_n_pages,
+            header.checksums_offset };
+}
+
+std::vector<uint64_t>
+read_write_set_checksums(int fd, const write_set_file_info_t& info)
+{
+    std::vector<uint64_t> checksums;
+    if (info.checksum_block_n_pages == 0) return checksums;
+
+    checksums.resize((info.n_pages + info.checksum_block_n_pages - 1) /
+            info.checksum_block_n_pages);
+    if (!pread_all(fd, checksums.data(), checksums.size() * sizeof(uint64_t),
+            info.checksums_offset))
+        print_message_and_die("could not read input file checksums");
+
+    return checksums;
+}
+
+void
+check_write_set_block(const char* filepath, const write_set_file_info_t& info,
+        const std::vector<uint64_t>& checksums, const uint64_t* entries,
+        uint64_t first_page, uint64_t n_pages)
+{
+    uint64_t block_n_pages = info.checksum_block_n_pages;
+    if (block_n_pages == 0) return;
+
+    for (uint64_t page = 0; page < n_pages; page += block_n_pages) {
+        uint64_t checksum_idx = (first_page + page) / block_n_pages;
+        if (get_write_set_checksum(entries + page,
+                MIN(block_n_pages, n_pages - page)) != checksums[checksum_idx])
+            print_message_and_die("input file %s fails its checksum at page "
+                    "%zu", filepath, first_page + page);
+    }
+}
+
+uint64_t
+get_write_set_header_checksum(const write_set_header_t& header,
+        const std::string& metadata)
+{
+    write_set_header_t unchecked = header;
+    unchecked.header_checksum = 0;
+
+    // the metadata, zero-padded to whole words
+    std::vector<uint64_t> words((sizeof(unchecked) + metadata.size() +
+            sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(words.data(), &unchecked, sizeof(unchecked));
+    memcpy((char*) words.data() + sizeof(unchecked), metadata.data(),
+            metadata.size());
+
+    return get_write_set_checksum(words.data(), words.size());
+}
+
+uint64_t
+get_write_set_checksum(const uint64_t* entries, size_t n_entries)
+{
+    uint64_t sum = 0;
+    uint64_t sum_of_sums = 0;
+    for (size_t i = 0; i < n_entries; ++i) {
+        sum += entries[i];
+        sum_of_sums += sum;
+    }
+
+    return sum ^ ((sum_of_sums << 32) | (sum_of_sums >> 32));
+}
+
+/*
+ * Reads size bytes at offset, asking for request_size (at least size) at
+ * first; the file may end anywhere past size.
+ */
+static bool
+pread_at_least(int fd, void* data, size_t size, size_t request_size,
+        uint64_t offset)
+{
+    size_t n_read = 0;
+    while (n_read < size) {
+        ssize_t ret = pread(fd, (char*) data + n_read, request_size - n_read,
+                offset + n_read);
+        if (ret == 0 or (ret == -1 and errno != EINTR)) return false;
+        if (ret > 0) n_read += ret;
+    }
+    return true;
+}
+
+bool
+pread_all(int fd, void* data, size_t size, uint64_t offset)
+{
+    return pread_at_least(fd, data, size, size, offset);
+}
+
+bool
+pread_all_direct(int fd, void* data, size_t size, uint64_t offset)
+{
+    size_t aligned_size = (size + WRITE_SET_PAYLOAD_ALIGNMENT - 1) &
+            ~(WRITE_SET_PAYLOAD_ALIGNMENT - 1);
+    return pread_at_least(fd, data, size, aligned_size, offset);
+}
+
+bool
+pwrite_all(int fd, const void* data, size_t size, uint64_t offset)
+{
+    size_t n_written = 0;
+    while (n_written < size) {
+        ssize_t ret = pwrite(fd, (const char*) data + n_written,
+                size - n_written, offset + n_written);
+        if (ret == -1 and errno != EINTR) return false;
+        if (ret > 0) n_written += ret;
+    }
+    return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * Self-describing write-set files: a small header, embedded metadata, and the
+ * write set itself (one 64-bit entry per page), 4 KiB-aligned so that it can
+ * be mapped (or read with O_DIRECT) as is, optionally followed by a checksum
+ * per block of entries. All values are stored in the writer's native byte
+ * order, which the header records; the loader only takes files in its own.
+ * Layout:
+ * - [0, payload_offset): write_set_header_t, then metadata_size bytes of
+ *   free-form metadata (conventionally "key=value" lines).
+ * - [payload_offset, + n_pages * 8): the entries.
+ * - [checksums_offset, + n_blocks * 8): if checksum_block_n_pages isn't 0,
+ *   the checksum of each checksum_block_n_pages entries (the last block
+ *   possibly shorter).
+ * Raw files, a bare dump of the entries, are still taken as they are.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+
+static constexpr char WRITE_SET_MAGIC[8] = { 'E', 'N', 'D', 'U', 'W', 'S',
+        'E', 'T' };
+static constexpr uint32_t WRITE_SET_VERSION = 1;
+// reads back as itself only in the writer's byte order
+static constexpr uint64_t WRITE_SET_BYTE_ORDER = 0x0102030405060708ull;
+static constexpr uint64_t WRITE_SET_PAYLOAD_ALIGNMENT = 4096;
+// checksum blocks must be a power of two of at most this many entries
+static constexpr uint64_t WRITE_SET_MAX_CHECKSUM_BLOCK_N_PAGES = 1 << 21;
+
+typedef struct {
+    char magic[8];                      // WRITE_SET_MAGIC
+    uint64_t byte_order;                // WRITE_SET_BYTE_ORDER
+    uint32_t version;                   // WRITE_SET_VERSION
+    uint32_t entry_bits;                // 64
+    uint64_t n_pages;
+    uint64_t payload_offset;            // WRITE_SET_PAYLOAD_ALIGNMENT-aligned
+    int64_t page_size;                  // bytes; 0 if not recorded
+    double time_units;                  // 0 if not recorded
+    uint64_t checksum_block_n_pages;    // 0 if no checksums
+    uint64_t checksums_offset;
+    uint64_t metadata_size;             // bytes, right after the header
+    uint64_t header_checksum;           // of the rest of it, and metadata
+} write_set_header_t;
+
+// an input file, as described by its header (or, if raw, by its size)
+typedef struct {
+    uint64_t n_pages;
+    uint64_t payload_offset;            // 0 for raw files
+    int64_t page_size;                  // 0 if not recorded
+    double time_units;                  // 0 if not recorded
+    uint64_t checksum_block_n_pages;    // 0 if no checksums
+    uint64_t checksums_offset;
+} write_set_file_info_t;
+
+/*
+ * Fills in info for the (open) input file of the given size, from its header
+ * if it has one, or as a raw dump otherwise. Dies if the file is malformed,
+ * or is a container this loader can't take as is.
+ */
+void read_write_set_file_info(int fd, size_t file_size,
+        write_set_file_info_t* info);
+
+/*
+ * Returns the (open) input file's block checksums, if it has any.
+ */
+std::vector<uint64_t> read_write_set_checksums(int fd,
+        const write_set_file_info_t& info);
+
+/*
+ * Checks the n_pages entries of the input file at filepath starting at
+ * first_page (a multiple of its checksum block size) against its checksums,
+ * as read by read_write_set_checksums(); dies on a mismatch. The entries
+ * must cover whole checksum blocks, but for the file's last, possibly
+ * shorter, one.
+ */
+void check_write_set_block(const char* filepath,
+        const write_set_file_info_t& info,
+        const std::vector<uint64_t>& checksums, const uint64_t* entries,
+        uint64_t first_page, uint64_t n_pages);
+
+/*
+ * Returns the header's checksum: of the header (but its own checksum field)
+ * and the metadata following it.
+ */
+uint64_t get_write_set_header_checksum(const write_set_header_t& header,
+        const std::string& metadata);
+
+/*
+ * Returns the checksum of a block of entries: Fletcher-style, two running
+ * 64-bit sums, so that it catches reordered as well as corrupted entries.
+ */
+uint64_t get_write_set_checksum(const uint64_t* entries, size_t n_entries);
+
+/*
+ * Read and write exactly size bytes at offset, resuming short transfers and
+ * retrying interrupted ones. Return false on EOF or error.
+ */
+bool pread_all(int fd, void* data, size_t size, uint64_t offset);
+bool pwrite_all(int fd, const void* data, size_t size, uint64_t offset);
+
+/*
+ * pread_all() for files opened with O_DIRECT, whose transfers must be
+ * block-aligned: reads in whole WRITE_SET_PAYLOAD_ALIGNMENT-byte blocks,
+ * so data must have room for size rounded up to one (the file may end
+ * within the last).
+ */
+bool pread_all_direct(int fd, void* data, size_t size, uint64_t offset);